@@ -8,1530 +8,6506 @@
 #include <cmath>
 #include <mutex>
 #include <future>
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <iomanip>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <new>
+#include <cstddef>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//GCC and Clang can build AVX2 functions into an otherwise plain x86-64 build,
+//which are only called once the CPU is known to have it
+#if defined(__GNUC__) && defined(__x86_64__)
+#define LINE_OF_SIGHT_AVX2
+#include <immintrin.h>
+#endif
+
+template <int TileSize> class BasicBlockGrid;
+template <int TileSize> class BasicBlockGridView;
+
+//the game's grid. Other tile sizes exist for benchmarking
+using BlockGrid = BasicBlockGrid<25>;
+using BlockGridView = BasicBlockGridView<25>;
+
+//the simulation advances in fixed ticks so that a run can be replayed exactly
+const int ticksPerSecond = 100;
+
+enum class Outcome : std::uint8_t
+{
+	Playing,
+	Won,
+	Died
+};
 
-class BlockGrid;
-
-float pointDirection(sf::Vector2f looker, sf::Vector2f target);
-template <typename T> int sign(T val);
-bool lineOfSight(sf::Vector2f point1, sf::Vector2f point2, BlockGrid & grid);
-float distance(sf::Vector2f point1, sf::Vector2f point2);
+//how a BlockGrid keeps its blocks. Bits is one bit per block, Runs is each
+//column's solid blocks as runs, which is smaller when blocks are few
+enum class BlockStorage : std::uint8_t
+{
+	Bits,
+	Runs
+};
 
-class Screen
+//how much of the level off screen is simulated. Turrets on screen are updated
+//every tick, moving turrets up to margin pixels beyond it move a tile at a time
+//without looking or shooting, and everything further away sleeps
+struct SimulationDetail
 {
-public:
-	virtual Screen * update(sf::RenderWindow & window) = 0;
-	virtual void draw(sf::RenderTarget & target) = 0;
+	std::int32_t margin = 350;
+
+	//ticks between a turret's coarse moves, and the most turrets moved coarsely in one tick
+	std::uint32_t coarseInterval = 4;
+	std::uint32_t coarseBudget = 16;
 };
 
-class Random
+struct Settings
 {
-	std::default_random_engine engine;
+	std::string recordPath;
+	std::string levelPath;
 
-public:
-	Random()
-	{
-		std::random_device device;
+	BlockStorage blockStorage;
 
-		engine.seed(device());
-	}
+	SimulationDetail detail;
 
-	Random(long seed)
-	{
-		engine.seed(seed);
-	}
+	//bullets destroy the blocks they hit
+	bool destructible;
 
-	bool nextBool()
-	{
-		std::uniform_int_distribution<int> distribution(0, 1);
+	//turrets fire the emitter patterns instead of single shots
+	bool patterns;
 
-		return distribution(engine) != 0;
-	}
+	//moving turrets keep apart and do not move through each other
+	bool crowd;
 
-	int nextInt()
-	{
-		return engine();
-	}
+	//milliseconds a frame, its tick and its drawing, may take before the game
+	//starts giving up fidelity to keep up, or zero to never give any up
+	float frameBudget = 1000.f/ticksPerSecond;
+};
 
-	int nextInt(int n)
-	{
-		std::uniform_int_distribution<int> distribution(0, n - 1);
+Settings settings;
 
-		return distribution(engine);
-	}
+//build with COUNT_ALLOCATIONS defined to count every global operator new, so
+//--test-allocations can check that a warmed up game tick never allocates
+#ifdef COUNT_ALLOCATIONS
 
+std::atomic<long> allocationCount(0);
 
-	float nextFloat()
-	{
-		std::uniform_real_distribution<float> distribution(0.f, 1.f);
+void * operator new(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
 
-		return distribution(engine);
-	}
+	void * memory = std::malloc(size == 0 ? 1 : size);
 
-	double nextDouble()
-	{
-		std::uniform_real_distribution<double> distribution(0.f, 1.f);
+	if (memory == nullptr)
+		throw std::bad_alloc();
 
-		return distribution(engine);
-	}
+	return memory;
+}
 
-	void setSeed(long seed)
-	{
-		engine.seed(seed);
-	}
+void * operator new[](std::size_t size)
+{
+	return operator new(size);
+}
 
-	int random_range(int lowerBound, int upperBound)
-	{
-		return nextInt(upperBound) + lowerBound;//TODO: fix this
-	}
+void operator delete(void * memory) noexcept
+{
+	std::free(memory);
+}
 
-	int irandom_range(int lowerBound, int upperBound)
-	{
-		int number = nextInt((upperBound + 1) - lowerBound) + lowerBound;
+void operator delete[](void * memory) noexcept
+{
+	std::free(memory);
+}
 
-		return number;
-	}
+void operator delete(void * memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void * memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+#endif
+
+//build with ENABLE_PROFILER defined to time each phase of a game tick and frame.
+//Without it the PROFILE_ macros expand to nothing
+enum ProfilePhase
+{
+	PhaseTick,
+	PhaseBullets,
+	PhaseActivation,
+	PhaseTurrets,
+	PhasePlayer,
+	PhaseBulletRemoval,
+	PhaseKillCheck,
+	PhaseDraw,
+	PhaseDrawGrid,
+	PhaseDrawZones,
+	PhaseDrawEntities,
+	PhaseCount
 };
 
-class BlockGrid
+enum ProfileCounter
 {
-	friend void generate(BlockGrid & grid);
+	CounterBullets,
+	CounterCoarseTurrets,
+	CounterActiveTurrets,
+	CounterRays,
+	CounterGovernorLevel,
+	CounterCulledBullets,
+	CounterStaleSights,
+	CounterDroppedShots,
+	CounterShedTurrets,
+	CounterScripts,
+	CounterCount
+};
 
-	int blockSize;
+const char * const phaseNames[PhaseCount] = {"tick", "bullets", "activation", "turrets", "player", "bullet removal", "kill check", "draw", "grid", "zones", "entities"};
+const char * const counterNames[CounterCount] = {"bullets", "coarse turrets", "active turrets", "LOS rays", "governor level", "bullets not drawn", "sights reused", "shots dropped", "coarse turrets shed", "scripts resumed"};
 
-	std::vector<std::vector<bool>> blocks;
+#ifdef ENABLE_PROFILER
 
-	sf::Vector2i size;
+class Profiler
+{
+	static const int sampleCount = 256;
 
-	void setSolid(int x, int y, bool solid)
-	{
-		assert(x >= 0 && x < size.x && y >= 0 && y < size.y);
+	//microseconds, written round robin so only the last sampleCount are kept
+	float samples[PhaseCount][sampleCount];
 
-		blocks[x][y] = solid;
-	}
+	int written[PhaseCount];
 
-public:
-	BlockGrid(sf::Vector2i size) : blockSize(25), size(size)
-	{
-		blocks.resize(size.x);
+	long counting[CounterCount];
+	long counters[CounterCount];
 
-		for (auto & vector : blocks)
-			vector.resize(size.y);
+	sf::Text text;
 
-		for (int x = 0; x < size.x; ++x)
-			for (int y = 0; y < size.y; ++y)
-				blocks[x][y] = false;
-	}
+public:
+	bool visible;
 
-	bool isSolid(int x, int y)
+	Profiler() : visible(false)
 	{
-		assert(x >= 0 && x < size.x && y >= 0 && y < size.y);
+		std::fill(written, written + PhaseCount, 0);
+		std::fill(counting, counting + CounterCount, 0);
+		std::fill(counters, counters + CounterCount, 0);
+	}
 
-		return blocks[x][y];
+	void addSample(ProfilePhase phase, float microseconds)
+	{
+		samples[phase][written[phase]++ % sampleCount] = microseconds;
 	}
 
-	sf::Vector2i getSize() {return size;}
+	void count(ProfileCounter counter, long amount) {counting[counter] += amount;}
 
-	int getBlockSize() {return blockSize;}
+	//counters show the totals of the last finished tick
+	void beginTick()
+	{
+		std::copy(counting, counting + CounterCount, counters);
+		std::fill(counting, counting + CounterCount, 0);
+	}
 
-	void draw(sf::RenderTarget & target, sf::FloatRect bounds)
+	void draw(sf::RenderTarget & target, sf::Font & font)
 	{
-		static sf::RectangleShape rectangle(sf::Vector2f(blockSize, blockSize));
+		std::ostringstream stream;
 
-		int leftBlockBound = bounds.left/blockSize;
-		int rightBlockBound = (bounds.left + bounds.width)/blockSize;
-		int topBlockBound = bounds.top/blockSize;
-		int bottomBlockBound = (bounds.top + bounds.height)/blockSize;
+		stream << std::fixed << std::setprecision(1) << "phase (us)  min / avg / p99\n";
 
-		if (leftBlockBound < 0)
-			leftBlockBound = 0;
+		for (int phase = 0; phase < PhaseCount; ++phase)
+		{
+			int count = std::min(written[phase], sampleCount);
 
-		if (topBlockBound < 0)
-			topBlockBound = 0;
+			if (count == 0)
+				continue;
 
-		if (rightBlockBound > size.x)
-			rightBlockBound = size.x;
+			float sorted[sampleCount];
 
-		if (bottomBlockBound > size.y)
-			bottomBlockBound = size.y;
+			std::copy(samples[phase], samples[phase] + count, sorted);
+			std::sort(sorted, sorted + count);
 
-		for (int x = leftBlockBound; x < rightBlockBound; ++x)
-			for (int y = topBlockBound; y < bottomBlockBound; ++y)
-			{
-				if (blocks[x][y])
-					rectangle.setFillColor(sf::Color::Black);
-				else
-					rectangle.setFillColor(sf::Color::White);
+			float total = 0;
 
-				rectangle.setPosition(x*blockSize, y*blockSize);
+			for (int i = 0; i < count; ++i)
+				total += sorted[i];
 
-				target.draw(rectangle);
-			}
-	}
+			stream << (phase == PhaseTick || phase == PhaseDraw ? "" : " ") << phaseNames[phase] << ": " << sorted[0] << " / " << total/count << " / " << sorted[(count - 1)*99/100] << "\n";
+		}
 
-	BlockGrid getSubset(sf::FloatRect bounds)
-	{
-		int leftBlockBound = bounds.left/blockSize;
-		int rightBlockBound = (bounds.left + bounds.width)/blockSize;
-		int topBlockBound = bounds.top/blockSize;
-		int bottomBlockBound = (bounds.top + bounds.height)/blockSize;
+		for (int counter = 0; counter < CounterCount; ++counter)
+			stream << counterNames[counter] << ": " << counters[counter] << "\n";
 
-		if (leftBlockBound < 0)
-			leftBlockBound = 0;
+		text.setFont(font);
+		text.setCharacterSize(14);
+		text.setFillColor(sf::Color::Blue);
+		text.setString(stream.str());
+		text.setPosition(5, 5);
 
-		if (topBlockBound < 0)
-			topBlockBound = 0;
+		target.draw(text);
+	}
+};
 
-		if (rightBlockBound > size.x)
-			rightBlockBound = size.x;
+//one per thread, so games played side by side by --bench batch each count their own
+thread_local Profiler profiler;
 
-		if (bottomBlockBound > size.y)
-			bottomBlockBound = size.y;
+#define PROFILE_COUNT(counter, amount) profiler.count(counter, amount)
+#define PROFILE_BEGIN_TICK() profiler.beginTick()
 
-		BlockGrid blockGrid(sf::Vector2i(rightBlockBound - leftBlockBound, bottomBlockBound - topBlockBound));
+#else
 
-		for (int x = leftBlockBound; x < rightBlockBound; ++x)
-			for (int y = topBlockBound; y < bottomBlockBound; ++y)
-				blockGrid.setSolid(x - leftBlockBound, y - topBlockBound, blocks[x][y]);
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_BEGIN_TICK() ((void)0)
 
-		return blockGrid;
-	}
-};
+#endif
+
+//build with ENABLE_TRACING defined and run with --trace file to write every
+//tick, frame and level generation as Chrome trace events (chrome://tracing or
+//ui.perfetto.dev). Each thread records into its own lock free ring and a
+//background thread writes them out, so the traced threads never block on IO
+#ifdef ENABLE_TRACING
 
-void generate(BlockGrid & grid)
+struct TraceEvent
 {
-	Random random;
+	const char * name;
 
-	for (int x = 3; x < grid.getSize().x - 4; ++x)
-		for (int y = 0; y < grid.getSize().y; ++y)
-			if (random.nextBool() && random.nextBool() && random.nextBool())
-				grid.setSolid(x, y, true);
-}
+	std::int64_t start;
+	std::int64_t duration;
+};
 
-class Bullet
+//single producer (the owning thread), single consumer (the writer thread)
+class TraceBuffer
 {
-	float speed;
-	float direction;
+	static const std::size_t capacity = 1 << 16;
 
-	int size;
+	TraceEvent events[capacity];
 
-	sf::Vector2f position;
+	std::atomic<std::size_t> head;
+	std::atomic<std::size_t> tail;
 
 public:
-	Bullet(sf::Vector2f position, int size, float speed, float direction) : position(position), size(size), speed(speed), direction(direction) {}
+	int threadId;
 
-	void update()
-	{
-		position.x += std::cos(direction)*speed;
-		position.y += std::sin(direction)*speed;
-	}
+	std::string threadName;
 
-	void draw(sf::RenderTarget & target)
+	std::atomic<long> dropped;
+
+	TraceBuffer(int threadId) : head(0), tail(0), threadId(threadId), dropped(0) {}
+
+	void push(const TraceEvent & event)
 	{
-		static sf::RectangleShape rectangle(sf::Vector2f(size, size));
+		std::size_t position = head.load(std::memory_order_relaxed);
 
-		rectangle.setFillColor(sf::Color::Black);
-		rectangle.setOrigin(size/2.f, size/2.f);
-		rectangle.setPosition(position);
+		if (position - tail.load(std::memory_order_acquire) == capacity)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
 
-		target.draw(rectangle);
+			return;
+		}
+
+		events[position % capacity] = event;
+
+		head.store(position + 1, std::memory_order_release);
 	}
 
-	sf::Vector2f getPosition() {return position;}
+	template <typename Function> void drain(Function function)
+	{
+		std::size_t position = tail.load(std::memory_order_relaxed);
+		std::size_t end = head.load(std::memory_order_acquire);
 
-	int getSize() {return size;}
+		for (; position != end; ++position)
+			function(events[position % capacity]);
 
-	bool operator==(const Bullet & other) {return (position == other.position && speed == other.speed && direction == other.direction);}
+		tail.store(position, std::memory_order_release);
+	}
 };
 
-class Turret
+class Tracer
 {
-	int size;
+	std::atomic<bool> active;
 
-	bool canShoot;
+	std::chrono::steady_clock::time_point epoch;
 
-	sf::Vector2f position;
-	
-	int shotsPerSecond;
+	std::ofstream file;
 
-	sf::Clock clock;
+	bool firstEvent;
+
+	std::mutex buffersMutex;
+
+	//never shrinks, threads keep pointers to their buffer
+	std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+	std::thread writer;
 
-	void shoot(sf::Vector2f target, std::vector<Bullet> & bullets)
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+
+	bool stopping;
+
+	void separate()
 	{
-		float angle = pointDirection(position, target);
+		if (!firstEvent)
+			file << ",\n";
 
-		bullets.push_back(Bullet(position, 10, 5, angle));
+		firstEvent = false;
 	}
 
-public:
-	Turret(sf::Vector2f position, int shotsPerSecond) : size(15), canShoot(false), position(position), shotsPerSecond(shotsPerSecond) {}
-
-	void update(sf::Vector2f target, std::vector<Bullet> & bullets, BlockGrid & grid)
+	void flush()
 	{
-		if (target == sf::Vector2f(0, 0))
-			return;
+		std::vector<TraceBuffer *> current;
 
-		if (canShoot && lineOfSight(position, target, grid))
 		{
-			canShoot = false;
-
-			clock.restart();
+			std::lock_guard<std::mutex> lock(buffersMutex);
 
-			shoot(target, bullets);
+			for (auto & buffer : buffers)
+				current.push_back(buffer.get());
 		}
 
-		if (!canShoot && shotsPerSecond != 0)
-		{
-			if (clock.getElapsedTime().asSeconds() > 1/shotsPerSecond)
-				canShoot = true;
-		}
+		for (TraceBuffer * buffer : current)
+			buffer->drain([this, buffer](const TraceEvent & event)
+			{
+				separate();
+
+				file << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId <<
+					",\"ts\":" << event.start/1000.0 << ",\"dur\":" << event.duration/1000.0 << "}";
+			});
 	}
 
-	void draw(sf::RenderTarget & target)
+	void write()
 	{
-		static sf::RectangleShape rectangle(sf::Vector2f(size, size));
+		std::unique_lock<std::mutex> lock(wakeMutex);
 
-		rectangle.setFillColor(sf::Color(255, 255, 0));
+		while (!stopping)
+		{
+			wake.wait_for(lock, std::chrono::milliseconds(20));
 
-		rectangle.setOrigin(rectangle.getSize().x/2, rectangle.getSize().y/2);
+			lock.unlock();
 
-		rectangle.setPosition(position);
+			flush();
 
-		target.draw(rectangle);
+			lock.lock();
+		}
 	}
 
-	sf::Vector2f getPosition() {return position;}
+	TraceBuffer * threadBuffer()
+	{
+		thread_local TraceBuffer * buffer = nullptr;
 
-	int getSize() {return size;}
+		if (buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(buffersMutex);
 
-	bool operator==(const Turret & other) {return position == other.position && shotsPerSecond == other.shotsPerSecond;}
-};
+			buffers.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer(buffers.size())));
 
-class MovingTurret
-{
-	float speed;
+			buffer = buffers.back().get();
+		}
 
-	sf::Vector2f position;
+		return buffer;
+	}
 
-	int size;
-	int shotsPerSecond;
-	
-	bool canShoot;
+public:
+	Tracer() : active(false), firstEvent(true), stopping(false) {}
 
-	sf::Clock clock;
+	~Tracer() {stop();}
 
-	void shoot(sf::Vector2f target, std::vector<Bullet> & bullets)
+	bool start(const std::string & path)
 	{
-		float angle = pointDirection(position, target);
+		file.open(path);
 
-		bullets.push_back(Bullet(position, 10, 5, angle));
-	}
+		if (!file)
+			return false;
 
-public:
-	MovingTurret(sf::Vector2f position, float speed, int shotsPerSecond) : position(position), speed(speed), shotsPerSecond(shotsPerSecond), canShoot(false), size(10)
-	{
+		file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
 
+		epoch = std::chrono::steady_clock::now();
+
+		writer = std::thread(&Tracer::write, this);
+
+		active.store(true);
+
+		return true;
 	}
 
-	void update(sf::Vector2f target, std::vector<Bullet> & bullets, BlockGrid & grid)
+	void stop()
 	{
-		if (target == sf::Vector2f(0, 0))
+		if (!active.exchange(false))
 			return;
 
-		bool hasLineOfSight = lineOfSight(position, target, grid);
-
-		if (canShoot && hasLineOfSight)
 		{
-			canShoot = false;
-
-			clock.restart();
+			std::lock_guard<std::mutex> lock(wakeMutex);
 
-			shoot(target, bullets);
+			stopping = true;
 		}
 
-		if (!canShoot && shotsPerSecond != 0)
-		{
-			if (clock.getElapsedTime().asSeconds() > 1/shotsPerSecond)
-				canShoot = true;
-		}
+		wake.notify_one();
 
-		if (!(distance(position, target) < 100 && hasLineOfSight))
+		writer.join();
+
+		flush();
+
+		long dropped = 0;
+
+		for (auto & buffer : buffers)
 		{
-			sf::Vector2f cornerPosition;
+			dropped += buffer->dropped.load();
 
-			cornerPosition.x = position.x - size/2;
-			cornerPosition.y = position.y - size/2;
+			if (!buffer->threadName.empty())
+			{
+				separate();
 
-			int xMove = target.x - position.x;
-			int yMove = target.y - position.y;
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+			}
+		}
 
-			if (std::abs(xMove) > speed)
-				xMove = xMove > 0 ? speed : -speed;
+		file << "\n]}\n";
 
-			if (std::abs(yMove) > speed)
-				yMove = yMove > 0 ? speed : -speed;
+		file.close();
 
-			int prevX = position.x;
-			int prevY = position.y;
+		if (dropped > 0)
+			std::cerr << "Trace dropped " << dropped << " events, the writer could not keep up" << std::endl;
+	}
 
-			for (int i = 0; i < std::abs(xMove); ++i)
-			{
-				int increment = sign(xMove);
+	bool isActive() {return active.load(std::memory_order_relaxed);}
 
-				position.x += increment;
+	//names the calling thread in the trace, call before it records anything else
+	void nameThread(const std::string & name)
+	{
+		TraceBuffer * buffer = threadBuffer();
 
-				std::vector<sf::Vector2i> blocks;
+		std::lock_guard<std::mutex> lock(buffersMutex);
 
-				blocks.push_back(sf::Vector2i((position.x - size/2)/grid.getBlockSize(), (position.y - size/2)/grid.getBlockSize()));
-				blocks.push_back(sf::Vector2i(std::ceil((position.x + size/2) /grid.getBlockSize()), std::ceil((position.y + size/2)/grid.getBlockSize())));
-				blocks.push_back(sf::Vector2i(std::ceil((position.x + size/2)/grid.getBlockSize()), (position.y - size/2)/grid.getBlockSize()));
-				blocks.push_back(sf::Vector2i((position.x - size/2)/grid.getBlockSize(), std::ceil((position.y + size/2)/grid.getBlockSize())));
+		buffer->threadName = name;
+	}
 
-				if (position.x < 0 || position.x > grid.getBlockSize()*grid.getSize().x - size)
-				{
-					position.x = prevX;
+	std::int64_t since(std::chrono::steady_clock::time_point time)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+	}
 
-					break;
-				}
+	std::int64_t now() {return since(std::chrono::steady_clock::now());}
+
+	void record(const char * name, std::int64_t start, std::int64_t end)
+	{
+		threadBuffer()->push(TraceEvent{name, start, end - start});
+	}
+};
+
+Tracer tracer;
+
+//name must be a string literal, only the pointer is recorded
+class TraceScope
+{
+	const char * name;
+
+	std::int64_t start;
+
+public:
+	TraceScope(const char * name) : name(name), start(tracer.isActive() ? tracer.now() : 0) {}
+
+	~TraceScope()
+	{
+		if (tracer.isActive())
+			tracer.record(name, start, tracer.now());
+	}
+};
+
+#endif
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+
+#if defined(ENABLE_PROFILER) || defined(ENABLE_TRACING)
+
+//feeds the profiler overlay and the trace from the same timer
+class PhaseScope
+{
+	ProfilePhase phase;
+
+	std::chrono::steady_clock::time_point start;
+
+public:
+	PhaseScope(ProfilePhase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+
+	~PhaseScope()
+	{
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+#ifdef ENABLE_PROFILER
+		profiler.addSample(phase, std::chrono::duration<float, std::micro>(end - start).count());
+#endif
+
+#ifdef ENABLE_TRACING
+		if (tracer.isActive())
+			tracer.record(phaseNames[phase], tracer.since(start), tracer.since(end));
+#endif
+	}
+};
+
+#define PROFILE_SCOPE(phase) PhaseScope PROFILE_CONCATENATE(profileScope, __LINE__)(phase)
+
+#else
+
+#define PROFILE_SCOPE(phase)
+
+#endif
+
+#ifdef ENABLE_TRACING
+#define TRACE_SCOPE(name) TraceScope PROFILE_CONCATENATE(traceScope, __LINE__)(name)
+#define TRACE_THREAD(name) tracer.nameThread(name)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD(name) ((void)0)
+#endif
+
+float pointDirection(sf::Vector2f looker, sf::Vector2f target);
+template <typename T> int sign(T val);
+template <typename Grid> bool lineOfSight(sf::Vector2f point1, sf::Vector2f point2, Grid & grid);
+float distance(sf::Vector2f point1, sf::Vector2f point2);
+
+class Screen
+{
+public:
+	virtual Screen * update(sf::RenderWindow & window) = 0;
+	virtual void draw(sf::RenderTarget & target) = 0;
+};
+
+class Random
+{
+	std::default_random_engine engine;
+
+public:
+	Random()
+	{
+		std::random_device device;
+
+		engine.seed(device());
+	}
+
+	Random(long seed)
+	{
+		engine.seed(seed);
+	}
+
+	bool nextBool()
+	{
+		std::uniform_int_distribution<int> distribution(0, 1);
+
+		return distribution(engine) != 0;
+	}
+
+	int nextInt()
+	{
+		return engine();
+	}
+
+	int nextInt(int n)
+	{
+		std::uniform_int_distribution<int> distribution(0, n - 1);
+
+		return distribution(engine);
+	}
+
+
+	float nextFloat()
+	{
+		std::uniform_real_distribution<float> distribution(0.f, 1.f);
+
+		return distribution(engine);
+	}
+
+	double nextDouble()
+	{
+		std::uniform_real_distribution<double> distribution(0.f, 1.f);
+
+		return distribution(engine);
+	}
+
+	void setSeed(long seed)
+	{
+		engine.seed(seed);
+	}
+
+	int random_range(int lowerBound, int upperBound)
+	{
+		return nextInt(upperBound) + lowerBound;//TODO: fix this
+	}
+
+	int irandom_range(int lowerBound, int upperBound)
+	{
+		int number = nextInt((upperBound + 1) - lowerBound) + lowerBound;
+
+		return number;
+	}
+};
+
+//hands out memory by bumping an offset and takes it all back at once with
+//reset(), for containers that only live for a single tick. Requests that do
+//not fit borrow from the heap until the next reset, which then grows the arena
+//to the most it has ever been asked for, so a warmed up arena never allocates
+class FrameArena
+{
+	std::unique_ptr<char[]> block;
+
+	std::size_t capacity;
+	std::size_t used;
+
+	std::vector<std::unique_ptr<char[]>> overflow;
+
+	std::size_t overflowBytes;
+
+	std::size_t highWaterMark;
+
+public:
+	//resets the arena when it goes out of scope
+	class Frame
+	{
+		FrameArena & arena;
+
+	public:
+		Frame(FrameArena & arena) : arena(arena) {}
+
+		~Frame() {arena.reset();}
+	};
+
+	FrameArena(std::size_t capacity = 64*1024) : block(new char[capacity]), capacity(capacity), used(0), overflowBytes(0), highWaterMark(0) {}
+
+	FrameArena(const FrameArena &) = delete;
+	FrameArena & operator=(const FrameArena &) = delete;
+
+	void * allocate(std::size_t bytes, std::size_t alignment)
+	{
+		assert(alignment <= alignof(std::max_align_t));
+
+		std::size_t start = (used + alignment - 1) & ~(alignment - 1);
+
+		if (start + bytes <= capacity)
+		{
+			used = start + bytes;
+
+			return block.get() + start;
+		}
+
+		overflow.push_back(std::unique_ptr<char[]>(new char[bytes]));
+
+		overflowBytes += bytes;
+
+		return overflow.back().get();
+	}
+
+	void reset()
+	{
+		highWaterMark = std::max(highWaterMark, used + overflowBytes);
+
+		if (!overflow.empty())
+		{
+			overflow.clear();
+
+			capacity = highWaterMark + highWaterMark/4;
+
+			block.reset(new char[capacity]);
+		}
+
+		used = 0;
+		overflowBytes = 0;
+	}
+
+	//the most bytes handed out between two resets, which is what the arena should be sized for
+	std::size_t getHighWaterMark() {return std::max(highWaterMark, used + overflowBytes);}
+
+	std::size_t getCapacity() {return capacity;}
+};
+
+//lets standard containers draw from a FrameArena. Freeing does nothing, the
+//memory comes back when the arena is reset, so the container must not outlive that
+template <typename T> class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameArena * arena;
+
+	ArenaAllocator(FrameArena & arena) : arena(&arena) {}
+
+	template <typename U> ArenaAllocator(const ArenaAllocator<U> & other) : arena(other.arena) {}
+
+	T * allocate(std::size_t count) {return static_cast<T *> (arena->allocate(count*sizeof(T), alignof(T)));}
+
+	void deallocate(T *, std::size_t) {}
+};
+
+template <typename T, typename U> bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) {return a.arena == b.arena;}
+template <typename T, typename U> bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) {return a.arena != b.arena;}
+
+template <typename T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+//read only view of a whole file, shared by everything that points into it
+class MappedFile
+{
+	const char * data;
+
+	std::size_t size;
+
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+public:
+	MappedFile() : data(nullptr), size(0)
+	{
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#endif
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+#else
+		if (data != nullptr)
+			munmap(const_cast<char *> (data), size);
+#endif
+	}
+
+	bool open(const std::string & path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			return false;
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (mapping == nullptr)
+			return false;
+
+		data = static_cast<const char *> (MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+		size = fileSize.QuadPart;
+
+		return data != nullptr;
+#else
+		int descriptor = ::open(path.c_str(), O_RDONLY);
+
+		if (descriptor < 0)
+			return false;
+
+		struct stat status;
+
+		if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+		{
+			close(descriptor);
+
+			return false;
+		}
+
+		void * address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+		close(descriptor);
+
+		if (address == MAP_FAILED)
+			return false;
+
+		data = static_cast<const char *> (address);
+		size = status.st_size;
+
+		return true;
+#endif
+	}
+
+	const char * getData() {return data;}
+
+	std::size_t getSize() {return size;}
+};
+
+int countTrailingZeros(std::uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+
+	_BitScanForward64(&index, word);
+
+	return index;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+//the first row from y up to end whose bit is set once flipped, or end. A flip
+//of 0 finds solid blocks and a flip of all ones finds empty ones
+int findBit(const std::uint64_t * column, int y, int end, std::uint64_t flip)
+{
+	while (y < end)
+	{
+		std::uint64_t word = (column[y >> 6] ^ flip) >> (y & 63);
+
+		if (word)
+			return std::min(end, y + countTrailingZeros(word));
+
+		y = (y | 63) + 1;
+	}
+
+	return end;
+}
+
+//solid blocks from top up to but not including bottom, all in one column
+struct BlockRun
+{
+	std::uint16_t top;
+	std::uint16_t bottom;
+};
+
+//bytes a grid is using, split by what they are for
+struct BlockGridMemory
+{
+	std::size_t blocks;
+	std::size_t distances;
+	std::size_t pyramid;
+	std::size_t changes;
+
+	std::size_t total() const {return blocks + distances + pyramid + changes;}
+};
+
+//the tile size is fixed at compile time, so tile lookups divide by a constant,
+//and by a power of two they become shifts and masks
+template <int TileSize>
+class BasicBlockGrid
+{
+	template <int Size> friend void generate(BasicBlockGrid<Size> & grid, Random & random);
+	template <int Size> friend void generate(BasicBlockGrid<Size> & grid, Random & random, float density);
+
+	friend class BasicBlockGridView<TileSize>;
+
+	sf::Vector2i size;
+
+	//each column is packed into 64 bit words, one bit per block, starting at the top
+	int columnWords;
+
+	std::vector<std::uint64_t> storage;
+
+	//either storage.data(), a level file that mapping keeps alive, or null once
+	//the blocks have been packed into runs
+	const std::uint64_t * words;
+
+	std::shared_ptr<MappedFile> mapping;
+
+	BlockStorage blockStorage;
+
+	//with Runs storage, each column's runs from top to bottom. Column x has
+	//the runs from columnRuns[x] up to columnRuns[x + 1]
+	std::vector<std::uint32_t> columnRuns;
+	std::vector<BlockRun> runs;
+
+	//for each block, how many blocks away the nearest solid one is, counting
+	//diagonal steps as one and capped at maxDistance. 0 for solid blocks.
+	//distancePadding more bytes follow, so 4 byte gathers can read the last one
+	std::vector<std::uint8_t> distances;
+	std::vector<std::uint8_t> scratch;
+
+	//a mip pyramid of empty block counts. Level n counts squares 2^n blocks
+	//across, level 0 is read straight from the blocks and is not stored
+	std::vector<std::vector<std::uint32_t>> emptyCounts;
+
+	//every block setSolid has changed, in order. Anything built from the blocks
+	//outside the grid catches up by going over the changes since it last looked
+	std::vector<sf::Vector2i> changes;
+
+	int levelHeight(int level) {return (size.y + (1 << level) - 1) >> level;}
+
+	int topLevel() {return emptyCounts.empty() ? 0 : emptyCounts.size() - 1;}
+
+	void buildPyramid()
+	{
+		emptyCounts.resize(1);
+
+		for (int level = 1; ((size.x - 1) >> (level - 1)) > 0 || ((size.y - 1) >> (level - 1)) > 0; ++level)
+		{
+			int width = (size.x + (1 << level) - 1) >> level;
+			int height = levelHeight(level);
+
+			std::vector<std::uint32_t> counts(width*height);
+
+			for (int x = 0; x < width; ++x)
+				for (int y = 0; y < height; ++y)
+					for (int child = 0; child < 4; ++child)
+					{
+						int childX = x*2 + (child >> 1);
+						int childY = y*2 + (child & 1);
+
+						if (level == 1)
+							counts[x*height + y] += (childX < size.x && childY < size.y && !isSolid(childX, childY));
+						else if (childX < ((size.x + (1 << (level - 1)) - 1) >> (level - 1)) && childY < levelHeight(level - 1))
+							counts[x*height + y] += emptyCounts[level - 1][childX*levelHeight(level - 1) + childY];
+					}
+
+			emptyCounts.push_back(std::move(counts));
+		}
+	}
+
+	//empty blocks in the part of a pyramid node that is inside the rectangle
+	int countEmpty(int level, int x, int y, int left, int top, int right, int bottom)
+	{
+		int nodeLeft = x << level;
+		int nodeTop = y << level;
+		int nodeRight = std::min(nodeLeft + (1 << level), size.x);
+		int nodeBottom = std::min(nodeTop + (1 << level), size.y);
+
+		if (nodeLeft >= right || nodeRight <= left || nodeTop >= bottom || nodeBottom <= top)
+			return 0;
+
+		if (level == 0)
+			return !isSolid(x, y);
+
+		if (left <= nodeLeft && nodeRight <= right && top <= nodeTop && nodeBottom <= bottom)
+			return emptyCounts[level][x*levelHeight(level) + y];
+
+		int count = 0;
+
+		for (int child = 0; child < 4; ++child)
+			count += countEmpty(level - 1, x*2 + (child >> 1), y*2 + (child & 1), left, top, right, bottom);
+
+		return count;
+	}
+
+	sf::Vector2i findEmpty(int level, int x, int y, int left, int top, int right, int bottom, int index)
+	{
+		if (level == 0)
+			return sf::Vector2i(x, y);
+
+		for (int child = 0; child < 4; ++child)
+		{
+			int count = countEmpty(level - 1, x*2 + (child >> 1), y*2 + (child & 1), left, top, right, bottom);
+
+			if (index < count)
+				return findEmpty(level - 1, x*2 + (child >> 1), y*2 + (child & 1), left, top, right, bottom, index);
+
+			index -= count;
+		}
+
+		assert(false);
+
+		return sf::Vector2i(-1, -1);
+	}
+
+	//recomputes the distances in a rectangle of blocks, bounds inclusive. Every
+	//solid block that could be nearest lies within maxDistance of it, so a
+	//chamfer pass over the rectangle grown by that much is exact inside it
+	void updateDistances(int left, int top, int right, int bottom)
+	{
+		left = std::max(left, 0);
+		top = std::max(top, 0);
+		right = std::min(right, size.x - 1);
+		bottom = std::min(bottom, size.y - 1);
+
+		if (left > right || top > bottom)
+			return;
+
+		int windowLeft = std::max(left - maxDistance, 0);
+		int windowTop = std::max(top - maxDistance, 0);
+		int width = std::min(right + maxDistance, size.x - 1) - windowLeft + 1;
+		int height = std::min(bottom + maxDistance, size.y - 1) - windowTop + 1;
+
+		scratch.resize(width*height);
+
+		std::fill(scratch.begin(), scratch.end(), maxDistance);
+
+		forEachSolidRun(windowLeft, windowTop, windowLeft + width, windowTop + height, [&](int x, int runTop, int runBottom)
+		{
+			std::fill_n(scratch.begin() + (x - windowLeft)*height + runTop - windowTop, runBottom - runTop, 0);
+		});
+
+		for (int x = 0; x < width; ++x)
+			for (int y = 0; y < height; ++y)
+			{
+				std::uint8_t & distance = scratch[x*height + y];
+
+				if (y > 0)
+					distance = std::min<std::uint8_t>(distance, scratch[x*height + y - 1] + 1);
+
+				if (x > 0)
+					for (int neighbour = std::max(y - 1, 0); neighbour <= std::min(y + 1, height - 1); ++neighbour)
+						distance = std::min<std::uint8_t>(distance, scratch[(x - 1)*height + neighbour] + 1);
+			}
+
+		for (int x = width - 1; x >= 0; --x)
+			for (int y = height - 1; y >= 0; --y)
+			{
+				std::uint8_t & distance = scratch[x*height + y];
+
+				if (y < height - 1)
+					distance = std::min<std::uint8_t>(distance, scratch[x*height + y + 1] + 1);
+
+				if (x < width - 1)
+					for (int neighbour = std::max(y - 1, 0); neighbour <= std::min(y + 1, height - 1); ++neighbour)
+						distance = std::min<std::uint8_t>(distance, scratch[(x + 1)*height + neighbour] + 1);
+			}
+
+		for (int x = left; x <= right; ++x)
+			for (int y = top; y <= bottom; ++y)
+				distances[x*size.y + y] = scratch[(x - windowLeft)*height + y - windowTop];
+	}
+
+	//turns the bits into runs and lets the bits go
+	void packRuns()
+	{
+		columnRuns.assign(1, 0);
+		runs.clear();
+
+		for (int x = 0; x < size.x; ++x)
+		{
+			forEachSolidRun(x, 0, x + 1, size.y, [&](int, int top, int bottom)
+			{
+				runs.push_back(BlockRun{static_cast<std::uint16_t> (top), static_cast<std::uint16_t> (bottom)});
+			});
+
+			columnRuns.push_back(runs.size());
+		}
+
+		runs.shrink_to_fit();
+
+		storage.clear();
+		storage.shrink_to_fit();
+
+		words = nullptr;
+
+		mapping.reset();
+	}
+
+	//the first of column x's runs that ends below row y
+	std::vector<BlockRun>::iterator findRun(int x, int y)
+	{
+		return std::upper_bound(runs.begin() + columnRuns[x], runs.begin() + columnRuns[x + 1], y, [](int row, const BlockRun & run) {return row < run.bottom;});
+	}
+
+	//moves where every column after x starts by change runs
+	void shiftColumns(int x, int change)
+	{
+		for (int column = x + 1; column <= size.x; ++column)
+			columnRuns[column] += change;
+	}
+
+	void setRun(int x, int y, bool solid)
+	{
+		std::vector<BlockRun>::iterator run = findRun(x, y);
+
+		bool inside = (run != runs.begin() + columnRuns[x + 1] && run->top <= y);
+
+		if (inside == solid)
+			return;
+
+		if (solid)
+		{
+			bool joinsAbove = (run != runs.begin() + columnRuns[x] && (run - 1)->bottom == y);
+			bool joinsBelow = (run != runs.begin() + columnRuns[x + 1] && run->top == y + 1);
+
+			if (joinsAbove && joinsBelow)
+			{
+				(run - 1)->bottom = run->bottom;
+
+				runs.erase(run);
+				shiftColumns(x, -1);
+			}
+			else if (joinsAbove)
+				(run - 1)->bottom = y + 1;
+			else if (joinsBelow)
+				run->top = y;
+			else
+			{
+				runs.insert(run, BlockRun{static_cast<std::uint16_t> (y), static_cast<std::uint16_t> (y + 1)});
+				shiftColumns(x, 1);
+			}
+		}
+		else if (run->top == y && run->bottom == y + 1)
+		{
+			runs.erase(run);
+			shiftColumns(x, -1);
+		}
+		else if (run->top == y)
+			run->top = y + 1;
+		else if (run->bottom == y + 1)
+			run->bottom = y;
+		else
+		{
+			BlockRun below = {static_cast<std::uint16_t> (y + 1), run->bottom};
+
+			run->bottom = y;
+
+			runs.insert(run + 1, below);
+			shiftColumns(x, 1);
+		}
+	}
+
+	//works out the distance field and the empty block pyramid from scratch, and
+	//packs the blocks into runs if the grid keeps them that way
+	void rebuild()
+	{
+		if (blockStorage == BlockStorage::Runs && words)
+			packRuns();
+
+		distances.resize(size.x*size.y + distancePadding);
+
+		updateDistances(0, 0, size.x - 1, size.y - 1);
+
+		buildPyramid();
+	}
+
+	//changes a block without touching what is kept alongside the blocks, for filling in a whole grid before rebuilding
+	void setBit(int x, int y, bool solid)
+	{
+		assert(x >= 0 && x < size.x && y >= 0 && y < size.y);
+
+		if (!words)
+		{
+			setRun(x, y, solid);
+
+			return;
+		}
+
+		if (words != storage.data())
+		{
+			storage.assign(words, words + size.x*columnWords);
+
+			words = storage.data();
+
+			mapping.reset();
+		}
+
+		std::uint64_t bit = std::uint64_t(1) << (y & 63);
+
+		if (solid)
+			storage[x*columnWords + (y >> 6)] |= bit;
+		else
+			storage[x*columnWords + (y >> 6)] &= ~bit;
+	}
+
+public:
+	static const int blockSize = TileSize;
+	static const int maxDistance = 15;
+	static const int distancePadding = 3;
+
+	//blocks are filled in as bits either way, and packed into runs by rebuild.
+	//Runs keep rows in 16 bits, so taller grids always keep bits
+	BasicBlockGrid(sf::Vector2i size, BlockStorage blockStorage = BlockStorage::Bits) : size(size), columnWords((size.y + 63)/64), storage(size.x*columnWords, 0), words(storage.data()),
+		blockStorage(size.y <= std::numeric_limits<std::uint16_t>::max() ? blockStorage : BlockStorage::Bits), distances(size.x*size.y + distancePadding, maxDistance)
+	{
+		buildPyramid();
+	}
+
+	//uses words in place, they must stay valid for as long as mapping does. Only the
+	//blocks are mapped: rebuild still works out the distance field, the pyramid and
+	//any runs over the whole grid, so loading takes time in proportion to its area
+	BasicBlockGrid(sf::Vector2i size, const std::uint64_t * words, std::shared_ptr<MappedFile> mapping, BlockStorage blockStorage = BlockStorage::Bits) : size(size), columnWords((size.y + 63)/64), words(words), mapping(mapping),
+		blockStorage(size.y <= std::numeric_limits<std::uint16_t>::max() ? blockStorage : BlockStorage::Bits)
+	{
+		rebuild();
+	}
+
+	BasicBlockGrid(const BasicBlockGrid & other) : size(other.size), columnWords(other.columnWords), storage(other.storage), words(other.mapping || !other.words ? other.words : storage.data()), mapping(other.mapping),
+		blockStorage(other.blockStorage), columnRuns(other.columnRuns), runs(other.runs), distances(other.distances), emptyCounts(other.emptyCounts), changes(other.changes) {}
+
+	BasicBlockGrid & operator=(const BasicBlockGrid & other)
+	{
+		size = other.size;
+		columnWords = other.columnWords;
+		storage = other.storage;
+		words = other.mapping || !other.words ? other.words : storage.data();
+		mapping = other.mapping;
+		blockStorage = other.blockStorage;
+		columnRuns = other.columnRuns;
+		runs = other.runs;
+		distances = other.distances;
+		emptyCounts = other.emptyCounts;
+		changes = other.changes;
+
+		return *this;
+	}
+
+	BasicBlockGrid(BasicBlockGrid &&) = default;
+	BasicBlockGrid & operator=(BasicBlockGrid &&) = default;
+
+	bool isSolid(int x, int y)
+	{
+		assert(x >= 0 && x < size.x && y >= 0 && y < size.y);
+
+		if (!words)
+		{
+			std::vector<BlockRun>::iterator run = findRun(x, y);
+
+			return run != runs.begin() + columnRuns[x + 1] && run->top <= y;
+		}
+
+		return (words[x*columnWords + (y >> 6)] >> (y & 63)) & 1;
+	}
+
+	//calls visit(x, top, bottom) for each run of solid blocks in the rectangle
+	//from (left, top) up to but not including (right, bottom), column by column
+	//and from the top down, with the runs cut to the rectangle. Empty blocks
+	//are skipped a word or a run at a time rather than looked at one by one
+	template <typename Visit>
+	void forEachSolidRun(int left, int top, int right, int bottom, Visit visit)
+	{
+		left = std::max(left, 0);
+		top = std::max(top, 0);
+		right = std::min(right, size.x);
+		bottom = std::min(bottom, size.y);
+
+		for (int x = left; x < right; ++x)
+			if (words)
+			{
+				const std::uint64_t * column = words + x*columnWords;
+
+				//small windows inside one word, like a bullet's, are walked in a register
+				if ((top >> 6) == ((bottom - 1) >> 6) && bottom - top < 64)
+				{
+					std::uint64_t bits = (column[top >> 6] >> (top & 63)) & ((std::uint64_t(1) << (bottom - top)) - 1);
+
+					for (int y = top; bits; )
+					{
+						int skip = countTrailingZeros(bits);
+						int length = countTrailingZeros(~(bits >> skip));
+
+						visit(x, y + skip, y + skip + length);
+
+						bits >>= skip + length;
+						y += skip + length;
+					}
+
+					continue;
+				}
+
+				for (int y = findBit(column, top, bottom, 0); y < bottom; )
+				{
+					int end = findBit(column, y, bottom, ~std::uint64_t(0));
+
+					visit(x, y, end);
+
+					y = findBit(column, end, bottom, 0);
+				}
+			}
+			else
+				for (std::vector<BlockRun>::iterator run = findRun(x, top); run != runs.begin() + columnRuns[x + 1] && run->top < bottom; ++run)
+					visit(x, std::max<int>(run->top, top), std::min<int>(run->bottom, bottom));
+	}
+
+	//whether a player a block across can get from column left to column right
+	//through empty blocks, stepping up, down, left and right. Each column's
+	//empty runs are joined to the runs they touch in the column before, so it
+	//takes time in proportion to the runs rather than the blocks
+	bool connects(int left, int right)
+	{
+		//run 0 stands for column left, and roots are always joined to the
+		//lower of the two, so a run can be reached exactly when its root is 0
+		std::vector<std::int32_t> parent(1, 0);
+
+		//the empty runs of the column before and this one, as top and bottom
+		std::vector<sf::Vector2i> previous;
+		std::vector<sf::Vector2i> current;
+
+		std::int32_t previousFirst = 0;
+
+		auto find = [&](std::int32_t run)
+		{
+			while (parent[run] != run)
+				run = parent[run] = parent[parent[run]];
+
+			return run;
+		};
+
+		for (int x = left; x <= right; ++x)
+		{
+			current.clear();
+
+			int y = 0;
+
+			forEachSolidRun(x, 0, x + 1, size.y, [&](int, int top, int bottom)
+			{
+				if (top > y)
+					current.push_back(sf::Vector2i(y, top));
+
+				y = bottom;
+			});
+
+			if (y < size.y)
+				current.push_back(sf::Vector2i(y, size.y));
+
+			std::int32_t first = parent.size();
+
+			for (std::size_t run = 0, touching = 0; run < current.size(); ++run)
+			{
+				parent.push_back(x == left ? 0 : first + run);
+
+				while (touching < previous.size() && previous[touching].y <= current[run].x)
+					++touching;
+
+				for (std::size_t other = touching; other < previous.size() && previous[other].x < current[run].y; ++other)
+				{
+					std::int32_t a = find(previousFirst + other);
+					std::int32_t b = find(first + run);
+
+					parent[std::max(a, b)] = std::min(a, b);
+				}
+			}
+
+			//every way on from column left crosses this column, so if none of
+			//its runs can be reached nothing further can be either
+			bool reached = false;
+
+			for (std::size_t run = 0; run < current.size() && !reached; ++run)
+				reached = find(first + run) == 0;
+
+			if (!reached)
+				return false;
+
+			std::swap(previous, current);
+
+			previousFirst = first;
+		}
+
+		return true;
+	}
+
+	sf::Vector2i getSize() {return size;}
+
+	int getBlockSize() {return blockSize;}
+
+	BlockStorage getBlockStorage() {return blockStorage;}
+
+	BlockGridMemory getMemory()
+	{
+		BlockGridMemory memory = {0, 0, 0, 0};
+
+		if (words)
+			memory.blocks = std::size_t(size.x)*columnWords*sizeof(std::uint64_t);
+
+		memory.blocks += columnRuns.capacity()*sizeof(std::uint32_t) + runs.capacity()*sizeof(BlockRun);
+		memory.distances = distances.capacity() + scratch.capacity();
+
+		for (std::vector<std::uint32_t> & counts : emptyCounts)
+			memory.pyramid += counts.capacity()*sizeof(std::uint32_t);
+
+		memory.changes = changes.capacity()*sizeof(sf::Vector2i);
+
+		return memory;
+	}
+
+	//blocks outside the grid count as far from everything
+	int getDistance(int x, int y)
+	{
+		if (x < 0 || x >= size.x || y < 0 || y >= size.y)
+			return maxDistance;
+
+		return distances[x*size.y + y];
+	}
+
+	//changes a block at runtime. The distance field and the pyramid are updated
+	//only around it, so the cost does not grow with the size of the grid
+	void setSolid(int x, int y, bool solid)
+	{
+		if (isSolid(x, y) == solid)
+			return;
+
+		setBit(x, y, solid);
+
+		updateDistances(x - maxDistance, y - maxDistance, x + maxDistance, y + maxDistance);
+
+		for (int level = 1; level <= topLevel(); ++level)
+			emptyCounts[level][(x >> level)*levelHeight(level) + (y >> level)] += (solid ? -1 : 1);
+
+		changes.push_back(sf::Vector2i(x, y));
+	}
+
+	const std::vector<sf::Vector2i> & getChanges() {return changes;}
+
+	//empty blocks from (left, top) up to but not including (right, bottom)
+	int countEmpty(int left, int top, int right, int bottom)
+	{
+		return countEmpty(topLevel(), 0, 0, left, top, right, bottom);
+	}
+
+	//the index-th empty block in the rectangle, counted in pyramid order rather
+	//than row by row. index must be less than countEmpty of the same rectangle
+	sf::Vector2i findEmpty(int left, int top, int right, int bottom, int index)
+	{
+		return findEmpty(topLevel(), 0, 0, left, top, right, bottom, index);
+	}
+
+	//how far a point can move, in x and y alike, before it could reach a solid block
+	float getClearance(sf::Vector2f point)
+	{
+		int distance = getDistance(std::floor(point.x/blockSize), std::floor(point.y/blockSize));
+
+		return (distance > 0 ? (distance - 1)*blockSize : 0);
+	}
+
+	//column by column, getSize().y bytes to a column
+	const std::uint8_t * getDistances() {return distances.data();}
+
+	int getColumnWords() {return columnWords;}
+
+	//null with Runs storage
+	const std::uint64_t * getWords() {return words;}
+
+	//the blocks from offset, size across, clipped to the grid
+	BasicBlockGridView<TileSize> getView(sf::Vector2i offset, sf::Vector2i viewSize)
+	{
+		sf::Vector2i end(std::min(offset.x + viewSize.x, size.x), std::min(offset.y + viewSize.y, size.y));
+
+		offset.x = std::max(offset.x, 0);
+		offset.y = std::max(offset.y, 0);
+
+		return BasicBlockGridView<TileSize>(*this, offset, sf::Vector2i(std::max(end.x - offset.x, 0), std::max(end.y - offset.y, 0)));
+	}
+
+	//the blocks under an area of the level in pixels
+	BasicBlockGridView<TileSize> getView(sf::FloatRect bounds)
+	{
+		int leftBlockBound = bounds.left/blockSize;
+		int rightBlockBound = (bounds.left + bounds.width)/blockSize;
+		int topBlockBound = bounds.top/blockSize;
+		int bottomBlockBound = (bounds.top + bounds.height)/blockSize;
+
+		return getView(sf::Vector2i(leftBlockBound, topBlockBound), sf::Vector2i(rightBlockBound - leftBlockBound, bottomBlockBound - topBlockBound));
+	}
+
+	void draw(sf::RenderTarget & target, sf::FloatRect bounds)
+	{
+		getView(bounds).draw(target);
+	}
+
+	//a copy of part of the grid that owns its blocks. getView reads the same
+	//blocks without copying them, for as long as the grid stays the same
+	BasicBlockGrid getSubset(sf::FloatRect bounds)
+	{
+		BasicBlockGridView<TileSize> view = getView(bounds);
+
+		BasicBlockGrid blockGrid(view.getSize());
+
+		for (int x = 0; x < view.getSize().x; ++x)
+			for (int y = 0; y < view.getSize().y; ++y)
+				blockGrid.setBit(x, y, view.isSolid(x, y));
+
+		blockGrid.rebuild();
+
+		return blockGrid;
+	}
+};
+
+template <int TileSize> const int BasicBlockGrid<TileSize>::blockSize;
+template <int TileSize> const int BasicBlockGrid<TileSize>::maxDistance;
+template <int TileSize> const int BasicBlockGrid<TileSize>::distancePadding;
+
+//a window onto part of a grid that reads the grid's own storage, so making one
+//copies and allocates nothing. Coordinates are relative to the window, and it
+//is only good until the grid it looks at changes
+template <int TileSize>
+class BasicBlockGridView
+{
+	BasicBlockGrid<TileSize> * grid;
+
+	sf::Vector2i offset;
+	sf::Vector2i size;
+
+	//the window's first column in the grid's storage, and the stride between
+	//columns. Null when the grid keeps runs, which are read through the grid
+	const std::uint64_t * words;
+	int columnWords;
+
+	const std::uint8_t * distances;
+	int distanceStride;
+
+public:
+	static const int blockSize = TileSize;
+	static const int maxDistance = BasicBlockGrid<TileSize>::maxDistance;
+
+	BasicBlockGridView(BasicBlockGrid<TileSize> & grid, sf::Vector2i offset, sf::Vector2i size) : grid(&grid), offset(offset), size(size), words(grid.words ? grid.words + offset.x*grid.columnWords : nullptr), columnWords(grid.columnWords), distances(grid.distances.data() + offset.x*grid.size.y + offset.y), distanceStride(grid.size.y) {}
+
+	bool isSolid(int x, int y)
+	{
+		assert(x >= 0 && x < size.x && y >= 0 && y < size.y);
+
+		if (!words)
+			return grid->isSolid(offset.x + x, offset.y + y);
+
+		int row = offset.y + y;
+
+		return (words[x*columnWords + (row >> 6)] >> (row & 63)) & 1;
+	}
+
+	template <typename Visit>
+	void forEachSolidRun(int left, int top, int right, int bottom, Visit visit)
+	{
+		left = std::max(left, 0);
+		top = std::max(top, 0);
+		right = std::min(right, size.x);
+		bottom = std::min(bottom, size.y);
+
+		grid->forEachSolidRun(offset.x + left, offset.y + top, offset.x + right, offset.y + bottom, [&](int x, int runTop, int runBottom)
+		{
+			visit(x - offset.x, runTop - offset.y, runBottom - offset.y);
+		});
+	}
+
+	sf::Vector2i getSize() {return size;}
+
+	sf::Vector2i getOffset() {return offset;}
+
+	int getBlockSize() {return blockSize;}
+
+	//measured over the whole grid, so walls just outside the window still count
+	int getDistance(int x, int y)
+	{
+		if (x < 0 || x >= size.x || y < 0 || y >= size.y)
+			return maxDistance;
+
+		return distances[x*distanceStride + y];
+	}
+
+	float getClearance(sf::Vector2f point)
+	{
+		int distance = getDistance(std::floor(point.x/blockSize), std::floor(point.y/blockSize));
+
+		return (distance > 0 ? (distance - 1)*blockSize : 0);
+	}
+
+	int countEmpty(int left, int top, int right, int bottom)
+	{
+		left = std::max(left, 0);
+		top = std::max(top, 0);
+		right = std::min(right, size.x);
+		bottom = std::min(bottom, size.y);
+
+		if (left >= right || top >= bottom)
+			return 0;
+
+		return grid->countEmpty(offset.x + left, offset.y + top, offset.x + right, offset.y + bottom);
+	}
+
+	sf::Vector2i findEmpty(int left, int top, int right, int bottom, int index)
+	{
+		left = std::max(left, 0);
+		top = std::max(top, 0);
+		right = std::min(right, size.x);
+		bottom = std::min(bottom, size.y);
+
+		return grid->findEmpty(offset.x + left, offset.y + top, offset.x + right, offset.y + bottom, index) - offset;
+	}
+
+	//draws the window's blocks where they are in the level
+	void draw(sf::RenderTarget & target)
+	{
+		sf::RectangleShape rectangle(sf::Vector2f(blockSize, blockSize));
+
+		for (int x = 0; x < size.x; ++x)
+			for (int y = 0; y < size.y; ++y)
+			{
+				if (isSolid(x, y))
+					rectangle.setFillColor(sf::Color::Black);
+				else
+					rectangle.setFillColor(sf::Color::White);
+
+				rectangle.setPosition((offset.x + x)*blockSize, (offset.y + y)*blockSize);
+
+				target.draw(rectangle);
+			}
+	}
+};
+
+template <int TileSize> const int BasicBlockGridView<TileSize>::blockSize;
+template <int TileSize> const int BasicBlockGridView<TileSize>::maxDistance;
+
+//the grid drawn as a vertex array per square of blocks. A chunk is rebuilt
+//only when a block in it changes, found from the grid's list of changes
+class BlockGridChunks
+{
+	static const int chunkSize = 16;
+
+	sf::Vector2i chunkCount;
+
+	std::vector<sf::VertexArray> chunks;
+	std::vector<std::uint8_t> dirty;
+
+	std::size_t changesSeen;
+
+	void build(BlockGrid & grid, int chunkX, int chunkY)
+	{
+		sf::VertexArray & vertices = chunks[chunkX*chunkCount.y + chunkY];
+
+		vertices.clear();
+
+		BlockGridView view = grid.getView(sf::Vector2i(chunkX*chunkSize, chunkY*chunkSize), sf::Vector2i(chunkSize, chunkSize));
+
+		const float blockSize = view.getBlockSize();
+
+		//one quad for each run of solid blocks
+		view.forEachSolidRun(0, 0, view.getSize().x, view.getSize().y, [&](int x, int top, int bottom)
+		{
+			sf::Vector2f corner((view.getOffset().x + x)*blockSize, (view.getOffset().y + top)*blockSize);
+			float height = (bottom - top)*blockSize;
+
+			vertices.append(sf::Vertex(corner, sf::Color::Black));
+			vertices.append(sf::Vertex(corner + sf::Vector2f(blockSize, 0), sf::Color::Black));
+			vertices.append(sf::Vertex(corner + sf::Vector2f(blockSize, height), sf::Color::Black));
+			vertices.append(sf::Vertex(corner + sf::Vector2f(0, height), sf::Color::Black));
+		});
+
+		dirty[chunkX*chunkCount.y + chunkY] = false;
+	}
+
+public:
+	BlockGridChunks(sf::Vector2i gridSize) : chunkCount((gridSize.x + chunkSize - 1)/chunkSize, (gridSize.y + chunkSize - 1)/chunkSize), chunks(chunkCount.x*chunkCount.y, sf::VertexArray(sf::Quads)), dirty(chunks.size(), true), changesSeen(0) {}
+
+	//for when the grid has been replaced rather than changed block by block
+	void invalidate(BlockGrid & grid)
+	{
+		std::fill(dirty.begin(), dirty.end(), true);
+
+		changesSeen = grid.getChanges().size();
+	}
+
+	//draws the chunks that overlap bounds, empty blocks are left to the background
+	void draw(sf::RenderTarget & target, BlockGrid & grid, sf::FloatRect bounds)
+	{
+		const std::vector<sf::Vector2i> & changes = grid.getChanges();
+
+		for (; changesSeen < changes.size(); ++changesSeen)
+			dirty[(changes[changesSeen].x/chunkSize)*chunkCount.y + changes[changesSeen].y/chunkSize] = true;
+
+		const int chunkPixels = chunkSize*grid.getBlockSize();
+
+		int left = std::max(0, static_cast<int> (std::floor(bounds.left/chunkPixels)));
+		int top = std::max(0, static_cast<int> (std::floor(bounds.top/chunkPixels)));
+		int right = std::min(chunkCount.x, static_cast<int> (std::ceil((bounds.left + bounds.width)/chunkPixels)));
+		int bottom = std::min(chunkCount.y, static_cast<int> (std::ceil((bounds.top + bounds.height)/chunkPixels)));
+
+		for (int x = left; x < right; ++x)
+			for (int y = top; y < bottom; ++y)
+			{
+				if (dirty[x*chunkCount.y + y])
+					build(grid, x, y);
+
+				target.draw(chunks[x*chunkCount.y + y]);
+			}
+	}
+};
+
+//every level has a way through from the start zone to the finish. One that
+//does not is filled in again with the random numbers that follow, and once
+//that has failed a few times a row across the middle is cleared
+template <int TileSize>
+void generate(BasicBlockGrid<TileSize> & grid, Random & random)
+{
+	TRACE_SCOPE("generate");
+
+	const int attempts = 8;
+
+	for (int attempt = 0; ; ++attempt)
+	{
+		for (int x = 3; x < grid.getSize().x - 4; ++x)
+			for (int y = 0; y < grid.getSize().y; ++y)
+				grid.setBit(x, y, random.nextBool() && random.nextBool() && random.nextBool());
+
+		if (grid.connects(0, grid.getSize().x - 1))
+			break;
+
+		if (attempt + 1 == attempts)
+		{
+			for (int x = 0; x < grid.getSize().x; ++x)
+				grid.setBit(x, grid.getSize().y/2, false);
+
+			break;
+		}
+	}
+
+	grid.rebuild();
+}
+
+//like generate, but with any fraction of solid blocks. Used to benchmark levels denser or emptier than the game makes
+template <int TileSize>
+void generate(BasicBlockGrid<TileSize> & grid, Random & random, float density)
+{
+	for (int x = 3; x < grid.getSize().x - 4; ++x)
+		for (int y = 0; y < grid.getSize().y; ++y)
+			if (random.nextFloat() < density)
+				grid.setBit(x, y, true);
+
+	grid.rebuild();
+}
+
+class Bullet
+{
+	friend class BulletStore;
+
+	//how far it moves each tick
+	sf::Vector2f velocity;
+
+	int size;
+
+	sf::Vector2f position;
+	sf::Vector2f previousPosition;
+
+	//filled in by the BulletStore that holds it. impact is how much of its
+	//last step the bullet travels before it hits something, and impactBlock the
+	//block it hits, or -1 if it leaves the level
+	std::uint32_t expiryTick;
+	std::uint32_t handle;
+
+	float impact;
+
+	sf::Vector2i impactBlock;
+
+public:
+	Bullet(sf::Vector2f position, int size, float speed, float direction) : velocity(std::cos(direction)*speed, std::sin(direction)*speed), size(size), position(position), previousPosition(position), expiryTick(0), handle(0), impact(1), impactBlock(-1, -1) {}
+
+	Bullet(sf::Vector2f position, int size, sf::Vector2f velocity) : velocity(velocity), size(size), position(position), previousPosition(position), expiryTick(0), handle(0), impact(1), impactBlock(-1, -1) {}
+
+	void update()
+	{
+		previousPosition = position;
+
+		position.x += velocity.x;
+		position.y += velocity.y;
+	}
+
+	//rectangle is the game's, shared by everything it draws
+	void draw(sf::RenderTarget & target, sf::RectangleShape & rectangle)
+	{
+		rectangle.setFillColor(sf::Color::Black);
+		rectangle.setSize(sf::Vector2f(size, size));
+		rectangle.setOrigin(size/2.f, size/2.f);
+		rectangle.setPosition(position);
+
+		target.draw(rectangle);
+	}
+
+	sf::Vector2f getPosition() {return position;}
+	sf::Vector2f getPreviousPosition() {return previousPosition;}
+
+	int getSize() {return size;}
+
+	std::uint32_t getExpiryTick() {return expiryTick;}
+
+	float getImpact() {return impact;}
+
+	bool operator==(const Bullet & other) {return (position == other.position && velocity == other.velocity);}
+};
+
+//when a point moving from start to end first enters the box, as a fraction of
+//the move, or a negative number if it never does. Touching an edge does not count
+float sweepPointBox(sf::Vector2f start, sf::Vector2f end, sf::FloatRect box)
+{
+	const float starts[2] = {start.x, start.y};
+	const float moves[2] = {end.x - start.x, end.y - start.y};
+	const float lows[2] = {box.left, box.top};
+	const float highs[2] = {box.left + box.width, box.top + box.height};
+
+	float enter = 0;
+	float leave = 1;
+
+	for (int axis = 0; axis < 2; ++axis)
+	{
+		if (moves[axis] == 0)
+		{
+			if (starts[axis] <= lows[axis] || starts[axis] >= highs[axis])
+				return -1;
+
+			continue;
+		}
+
+		float low = (lows[axis] - starts[axis])/moves[axis];
+		float high = (highs[axis] - starts[axis])/moves[axis];
+
+		if (low > high)
+			std::swap(low, high);
+
+		enter = std::max(enter, low);
+		leave = std::min(leave, high);
+	}
+
+	return (enter < leave ? enter : -1);
+}
+
+//when a bullet moving from start to end first touches a solid block, as a fraction
+//of the move, or a negative number if it does not. The whole path is tested
+//rather than just where it ends, so fast bullets cannot pass through walls.
+//hitBlock, if given, is set to the block it touches first
+template <typename Grid>
+float bulletGridCollision(sf::Vector2f start, sf::Vector2f end, int size, Grid & blockGrid, sf::Vector2i * hitBlock = nullptr)
+{
+	const float half = size/2.f;
+	const int blockSize = blockGrid.getBlockSize();
+
+	int leftBound = std::max(0, static_cast<int> (std::floor((std::min(start.x, end.x) - half)/blockSize)));
+	int topBound = std::max(0, static_cast<int> (std::floor((std::min(start.y, end.y) - half)/blockSize)));
+	int rightBound = std::min(blockGrid.getSize().x - 1, static_cast<int> (std::floor((std::max(start.x, end.x) + half)/blockSize)));
+	int bottomBound = std::min(blockGrid.getSize().y - 1, static_cast<int> (std::floor((std::max(start.y, end.y) + half)/blockSize)));
+
+	float first = -1;
+
+	for (int x = leftBound; x <= rightBound; ++x)
+		for (int y = topBound; y <= bottomBound; ++y)
+			if (blockGrid.isSolid(x, y))
+			{
+				//a bullet touches a block when its centre is inside the block grown by half the bullet
+				float time = sweepPointBox(start, end, sf::FloatRect(x*blockSize - half, y*blockSize - half, blockSize + size, blockSize + size));
+
+				if (time >= 0 && (first < 0 || time < first))
+				{
+					first = time;
+
+					if (hitBlock)
+						*hitBlock = sf::Vector2i(x, y);
+				}
+			}
+
+	return first;
+}
+
+//ticks until the bullet hits a wall or leaves the level, found by stepping it
+//exactly the way it will be stepped each tick, how much of its last step it
+//gets through and which block it hits. Bullets that never move never expire
+template <typename Grid>
+std::uint32_t bulletLifetime(Bullet bullet, Grid & grid, float & impact, sf::Vector2i & impactBlock)
+{
+	const float width = grid.getBlockSize()*grid.getSize().x;
+	const float height = grid.getBlockSize()*grid.getSize().y;
+
+	impact = 0;
+	impactBlock = sf::Vector2i(-1, -1);
+
+	sf::Vector2f position = bullet.getPosition();
+
+	if (position.x < 0 || position.x >= width || position.y < 0 || position.y >= height)
+		return 0;
+
+	if (bulletGridCollision(position, position, bullet.getSize(), grid, &impactBlock) >= 0)
+		return 0;
+
+	//how much further the bullet can go without its edge reaching a wall
+	float clearance = 0;
+
+	for (std::uint32_t ticks = 1; ; ++ticks)
+	{
+		bullet.update();
+
+		sf::Vector2f step = bullet.getPosition() - bullet.getPreviousPosition();
+		float stepLength = std::max(std::abs(step.x), std::abs(step.y));
+
+		if (clearance < stepLength)
+			clearance = grid.getClearance(bullet.getPreviousPosition()) - bullet.getSize()/2.f;
+
+		if (clearance >= stepLength)
+			clearance -= stepLength;
+		else
+		{
+			impact = bulletGridCollision(bullet.getPreviousPosition(), bullet.getPosition(), bullet.getSize(), grid, &impactBlock);
+
+			if (impact >= 0)
+				return ticks;
+		}
+
+		impact = 1;
+
+		position = bullet.getPosition();
+
+		if (position.x < 0 || position.x >= width || position.y < 0 || position.y >= height)
+			return ticks;
+
+		if (position == bullet.getPreviousPosition())
+			return std::numeric_limits<std::uint32_t>::max();
+	}
+}
+
+//the live bullets, kept packed together for updating and drawing. Each bullet's
+//expiry tick is worked out once when it is added, and the bullet is linked into
+//the timing wheel bucket for that tick, so retiring a tick's bullets never looks
+//at any of the others
+class BulletStore
+{
+	static const std::uint32_t wheelSize = 1024;
+	static const std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+	BlockGrid * grid;
+
+	std::uint32_t now;
+
+	//bullets that may still be added this tick, any more are dropped
+	std::uint32_t spawnLimit;
+	std::uint32_t spawned;
+
+	//every bullet ever added
+	std::uint64_t spawnedTotal;
+
+	std::vector<Bullet> bullets;
+
+	//by handle: where the bullet is in bullets, and its neighbours in its bucket
+	std::vector<std::uint32_t> indices;
+	std::vector<std::uint32_t> nextInBucket;
+	std::vector<std::uint32_t> previousInBucket;
+	std::vector<std::uint32_t> freeHandles;
+
+	std::uint32_t buckets[wheelSize];
+
+	//bullets expiring a whole turn of the wheel or more from now
+	std::uint32_t distant;
+
+	void predict(Bullet & bullet)
+	{
+		std::uint32_t lifetime = bulletLifetime(bullet, *grid, bullet.impact, bullet.impactBlock);
+
+		bullet.expiryTick = (lifetime == none ? none : now + lifetime);
+	}
+
+	void link(std::uint32_t handle, std::uint32_t expiryTick)
+	{
+		if (expiryTick == none)
+			return;
+
+		std::uint32_t & head = (expiryTick - now < wheelSize ? buckets[expiryTick % wheelSize] : distant);
+
+		nextInBucket[handle] = head;
+		previousInBucket[handle] = none;
+
+		if (head != none)
+			previousInBucket[head] = handle;
+
+		head = handle;
+	}
+
+	void unlink(std::uint32_t handle, std::uint32_t expiryTick)
+	{
+		if (expiryTick == none)
+			return;
+
+		std::uint32_t next = nextInBucket[handle];
+		std::uint32_t previous = previousInBucket[handle];
+
+		if (next != none)
+			previousInBucket[next] = previous;
+
+		if (previous != none)
+			nextInBucket[previous] = next;
+		else if (buckets[expiryTick % wheelSize] == handle)
+			buckets[expiryTick % wheelSize] = next;
+		else
+			distant = next;
+	}
+
+	void insert(Bullet bullet)
+	{
+		if (freeHandles.empty())
+		{
+			bullet.handle = indices.size();
+
+			indices.push_back(0);
+			nextInBucket.push_back(none);
+			previousInBucket.push_back(none);
+		}
+		else
+		{
+			bullet.handle = freeHandles.back();
+
+			freeHandles.pop_back();
+		}
+
+		indices[bullet.handle] = bullets.size();
+		bullets.push_back(bullet);
+
+		link(bullet.handle, bullet.expiryTick);
+	}
+
+	void remove(std::uint32_t handle)
+	{
+		std::uint32_t index = indices[handle];
+
+		bullets[index] = bullets.back();
+		indices[bullets[index].handle] = index;
+		bullets.pop_back();
+
+		freeHandles.push_back(handle);
+	}
+
+public:
+	BulletStore(BlockGrid & grid) : grid(&grid), now(0), spawnLimit(none), spawned(0), spawnedTotal(0), distant(none)
+	{
+		std::fill(buckets, buckets + wheelSize, none);
+	}
+
+	//bullets added from here on are spawned on this tick
+	void setTick(std::uint32_t tick)
+	{
+		now = tick;
+		spawned = 0;
+	}
+
+	//the most bullets added in one tick, none for no limit
+	void setSpawnLimit(std::uint32_t limit) {spawnLimit = limit;}
+
+	void add(Bullet bullet)
+	{
+		if (spawned == spawnLimit)
+		{
+			PROFILE_COUNT(CounterDroppedShots, 1);
+
+			return;
+		}
+
+		++spawned;
+		++spawnedTotal;
+
+		predict(bullet);
+
+		insert(bullet);
+	}
+
+	//adds a volley of count bullets from position, bullet i heading along
+	//directions[i] turned so that (1, 0) points along axis. Room is made for
+	//the whole volley before any of it is added
+	void addVolley(sf::Vector2f position, int size, float speed, sf::Vector2f axis, const sf::Vector2f * directions, std::uint32_t count)
+	{
+		std::uint32_t allowed = std::min(count, spawnLimit - spawned);
+
+		PROFILE_COUNT(CounterDroppedShots, count - allowed);
+
+		spawned += allowed;
+		spawnedTotal += allowed;
+
+		if (bullets.capacity() < bullets.size() + allowed)
+			reserve(std::max(bullets.size() + allowed, 2*bullets.capacity()));
+
+		for (std::uint32_t i = 0; i < allowed; ++i)
+		{
+			sf::Vector2f direction(axis.x*directions[i].x - axis.y*directions[i].y, axis.y*directions[i].x + axis.x*directions[i].y);
+
+			Bullet bullet(position, size, direction*speed);
+
+			predict(bullet);
+
+			insert(bullet);
+		}
+	}
+
+	//removes the bullets that expire on the current tick, adding the blocks
+	//that the ones hitting walls hit to impacts
+	template <typename Blocks>
+	void retire(Blocks & impacts)
+	{
+		if (now % wheelSize == 0)
+		{
+			std::uint32_t handle = distant;
+
+			distant = none;
+
+			while (handle != none)
+			{
+				std::uint32_t next = nextInBucket[handle];
+
+				link(handle, bullets[indices[handle]].expiryTick);
+
+				handle = next;
+			}
+		}
+
+		std::uint32_t & head = buckets[now % wheelSize];
+
+		for (std::uint32_t handle = head; handle != none; handle = nextInBucket[handle])
+		{
+			const Bullet & bullet = bullets[indices[handle]];
+
+			assert(bullet.expiryTick == now);
+
+			if (bullet.impactBlock.x >= 0)
+				impacts.push_back(bullet.impactBlock);
+
+			remove(handle);
+		}
+
+		head = none;
+	}
+
+	//works out again when the bullets that were going to hit any of these
+	//blocks expire, after the blocks are destroyed. No other bullet's path
+	//can change when blocks are only taken away
+	template <typename Blocks>
+	void repredict(const Blocks & destroyed)
+	{
+		for (Bullet & bullet : bullets)
+			if (bullet.impactBlock.x >= 0 && std::find(destroyed.begin(), destroyed.end(), bullet.impactBlock) != destroyed.end())
+			{
+				unlink(bullet.handle, bullet.expiryTick);
+
+				predict(bullet);
+
+				link(bullet.handle, bullet.expiryTick);
+			}
+	}
+
+	void clear()
+	{
+		bullets.clear();
+		indices.clear();
+		nextInBucket.clear();
+		previousInBucket.clear();
+		freeHandles.clear();
+
+		std::fill(buckets, buckets + wheelSize, none);
+		distant = none;
+	}
+
+	//replaces the bullets with ones taken from another store, as of the given tick
+	void assign(const std::vector<Bullet> & other, std::uint32_t tick)
+	{
+		clear();
+
+		now = tick;
+
+		for (const Bullet & bullet : other)
+			insert(bullet);
+	}
+
+	std::vector<Bullet>::iterator begin() {return bullets.begin();}
+	std::vector<Bullet>::iterator end() {return bullets.end();}
+
+	const std::vector<Bullet> & getBullets() const {return bullets;}
+
+	std::size_t size() const {return bullets.size();}
+
+	std::uint64_t getSpawnedCount() const {return spawnedTotal;}
+
+	void reserve(std::size_t count)
+	{
+		bullets.reserve(count);
+		indices.reserve(count);
+		nextInBucket.reserve(count);
+		previousInBucket.reserve(count);
+		freeHandles.reserve(count);
+	}
+};
+
+const std::uint32_t BulletStore::wheelSize;
+const std::uint32_t BulletStore::none;
+
+const float pi = 3.14159265f;
+
+//how a turret fires. A shot is volleys volleys, gap ticks apart. Each volley
+//is count bullets spread evenly over arc radians, centred on the target when
+//aimed, and otherwise on a heading that turns by spin radians every volley
+struct EmitterPattern
+{
+	const char * name;
+
+	std::uint32_t count;
+	float arc;
+
+	bool aimed;
+	float spin;
+
+	std::uint32_t volleys;
+	std::uint32_t gap;
+
+	float speed;
+	int size;
+};
+
+//the first is the single aimed shot turrets fire by default
+const EmitterPattern emitterPatterns[] =
+{
+	{"single", 1, 0, true, 0, 1, 0, 5, 10},
+	{"spread", 5, 0.8f, true, 0, 1, 0, 5, 10},
+	{"burst", 1, 0, true, 0, 4, 6, 6, 8},
+	{"spiral", 4, 2*pi, false, 0.3f, 6, 4, 3, 8},
+	{"ring", 16, 2*pi, true, 0, 1, 0, 4, 8}
+};
+
+const int emitterPatternCount = sizeof(emitterPatterns)/sizeof(emitterPatterns[0]);
+
+//the directions of every pattern's volley relative to its centre, and the
+//turn each makes a volley, as unit vectors worked out once so that firing
+//never needs trigonometry
+class EmitterTables
+{
+	std::vector<sf::Vector2f> directions;
+
+	std::size_t first[emitterPatternCount];
+
+	sf::Vector2f spins[emitterPatternCount];
+
+public:
+	EmitterTables()
+	{
+		for (int pattern = 0; pattern < emitterPatternCount; ++pattern)
+		{
+			const EmitterPattern & description = emitterPatterns[pattern];
+
+			//a whole circle has no ends, so it is split into count gaps rather than count - 1
+			bool circle = description.arc >= 2*pi;
+			float step = circle ? description.arc/description.count : (description.count > 1 ? description.arc/(description.count - 1) : 0);
+			float start = circle ? 0 : -description.arc/2;
+
+			first[pattern] = directions.size();
+
+			for (std::uint32_t i = 0; i < description.count; ++i)
+				directions.push_back(sf::Vector2f(std::cos(start + step*i), std::sin(start + step*i)));
+
+			spins[pattern] = sf::Vector2f(std::cos(description.spin), std::sin(description.spin));
+		}
+	}
+
+	const sf::Vector2f * getDirections(int pattern) const {return directions.data() + first[pattern];}
+
+	sf::Vector2f getSpin(int pattern) const {return spins[pattern];}
+};
+
+const EmitterTables emitterTables;
+
+//fires one turret's pattern, volley by volley. It lives in the turret, so
+//snapshots copy it along with the rest of the turret
+class Emitter
+{
+	std::uint8_t pattern;
+
+	//volleys left of the shot being fired, and the tick the next is due
+	std::uint8_t volleysLeft;
+	std::uint32_t nextVolleyTick;
+
+	//where an unaimed pattern points
+	sf::Vector2f heading;
+
+public:
+	Emitter(int pattern = 0) : pattern(pattern), volleysLeft(0), nextVolleyTick(0), heading(1, 0) {}
+
+	//fires one volley of the pattern straight away
+	void volley(sf::Vector2f position, sf::Vector2f target, BulletStore & bullets)
+	{
+		const EmitterPattern & description = emitterPatterns[pattern];
+
+		//a single aimed bullet goes exactly where turrets have always shot
+		if (description.count == 1 && description.aimed)
+		{
+			bullets.add(Bullet(position, description.size, description.speed, pointDirection(position, target)));
+
+			return;
+		}
+
+		sf::Vector2f axis = heading;
+
+		if (description.aimed)
+		{
+			sf::Vector2f toward = target - position;
+
+			float length = std::sqrt(toward.x*toward.x + toward.y*toward.y);
+
+			axis = (length > 0 ? toward/length : sf::Vector2f(1, 0));
+		}
+		else
+		{
+			sf::Vector2f spin = emitterTables.getSpin(pattern);
+
+			heading = sf::Vector2f(heading.x*spin.x - heading.y*spin.y, heading.y*spin.x + heading.x*spin.y);
+
+			//keep rounding from shrinking or growing it over many turns
+			heading /= std::sqrt(heading.x*heading.x + heading.y*heading.y);
+		}
+
+		bullets.addVolley(position, description.size, description.speed, axis, emitterTables.getDirections(pattern), description.count);
+	}
+
+	//starts a shot. Its volleys are fired by update as they come due
+	void fire(std::uint32_t tick)
+	{
+		volleysLeft = emitterPatterns[pattern].volleys;
+		nextVolleyTick = tick;
+	}
+
+	void update(sf::Vector2f position, sf::Vector2f target, BulletStore & bullets, std::uint32_t tick)
+	{
+		if (volleysLeft == 0 || tick < nextVolleyTick)
+			return;
+
+		volley(position, target, bullets);
+
+		--volleysLeft;
+		nextVolleyTick = tick + emitterPatterns[pattern].gap;
+	}
+
+	int getPattern() {return pattern;}
+
+	const EmitterPattern & getDescription() {return emitterPatterns[pattern];}
+};
+
+enum class ScriptWait : std::uint8_t
+{
+	Ticks,
+	Sight,
+	Done
+};
+
+//where a behaviour script is up to and what it keeps between waits
+struct ScriptFrame
+{
+	//the line it carries on from, 0 before it has started
+	std::uint32_t line;
+
+	ScriptWait wait;
+
+	//the tick a script waiting on ticks carries on at
+	std::uint32_t wake;
+
+	//for the script's own use, a tick and a count
+	std::uint32_t mark;
+	std::uint32_t count;
+};
+
+//behaviour scripts are functions that carry on from where they last waited,
+//each call running until the next wait. Anything a script needs across a wait
+//goes in its frame, never in locals. A wait for a tick that has already come
+//does not wait at all. Only one wait may go on each line
+#if defined(__has_attribute)
+#if __has_attribute(fallthrough)
+#define SCRIPT_FALLTHROUGH __attribute__((fallthrough))
+#endif
+#endif
+
+#ifndef SCRIPT_FALLTHROUGH
+#define SCRIPT_FALLTHROUGH ((void)0)
+#endif
+
+#define SCRIPT_BEGIN(frame) switch ((frame).line) { case 0:
+#define SCRIPT_END(frame) } (frame).wait = ScriptWait::Done
+#define SCRIPT_STOP(frame) do { (frame).wait = ScriptWait::Done; return; } while (false)
+#define SCRIPT_WAIT_UNTIL(frame, tick, wakeTick) do { (frame).wake = (wakeTick); (frame).wait = ScriptWait::Ticks; (frame).line = __LINE__; SCRIPT_FALLTHROUGH; case __LINE__: if ((tick) < (frame).wake) return; } while (false)
+#define SCRIPT_WAIT_TICKS(frame, tick, ticks) SCRIPT_WAIT_UNTIL(frame, tick, (tick) + (ticks))
+#define SCRIPT_WAIT_SIGHT(frame) do { (frame).wait = ScriptWait::Sight; (frame).line = __LINE__; return; case __LINE__:; } while (false)
+
+//the frames of every behaviour script in a game, side by side. There is no wake
+//queue: every tick the game asks isReady of each active turret's script, and only
+//carries on the ones that are, so a waiting or finished script still costs that
+//check. A script's frame stays its own even once it is done, as its owner keeps
+//the handle
+class ScriptScheduler
+{
+	std::vector<ScriptFrame> frames;
+
+public:
+	//a new script, carried on from its start at the first chance
+	std::uint32_t start()
+	{
+		ScriptFrame frame = {0, ScriptWait::Ticks, 0, 0, 0};
+
+		frames.push_back(frame);
+
+		return frames.size() - 1;
+	}
+
+	ScriptFrame & operator[](std::uint32_t handle) {return frames[handle];}
+
+	bool isWaitingForSight(std::uint32_t handle) {return frames[handle].wait == ScriptWait::Sight;}
+
+	//whether what the script waits for has happened, seen being whether its
+	//owner can see its target this tick
+	bool isReady(std::uint32_t handle, std::uint32_t tick, bool seen)
+	{
+		const ScriptFrame & frame = frames[handle];
+
+		return (frame.wait == ScriptWait::Ticks && tick >= frame.wake) || (frame.wait == ScriptWait::Sight && seen);
+	}
+
+	void reserve(std::size_t count)
+	{
+		frames.reserve(count);
+	}
+};
+
+static_assert(std::is_trivially_copyable<ScriptFrame>::value, "snapshots copy script frames with the scheduler");
+
+class Turret
+{
+	int size;
+
+	sf::Vector2f position;
+	
+	int shotsPerSecond;
+
+	Emitter emitter;
+
+	//the frame of its behaviour script in the game's ScriptScheduler
+	std::uint32_t script;
+
+public:
+	Turret(sf::Vector2f position, int shotsPerSecond) : size(15), position(position), shotsPerSecond(shotsPerSecond), script(0) {}
+
+	void setPattern(int pattern) {emitter = Emitter(pattern);}
+
+	void setScript(std::uint32_t frame) {script = frame;}
+
+	std::uint32_t getScript() {return script;}
+
+	//the turret's behaviour script, carried on only on ticks the turret is on
+	//screen and the player is out in the open. It reloads on the first of those
+	//more than a second's share of shots after its last shot began, waits from
+	//the next for the player to come into sight, then fires its pattern volley
+	//by volley. frame.mark is when the last shot began
+	void run(ScriptFrame & frame, sf::Vector2f target, BulletStore & bullets, std::uint32_t tick)
+	{
+		SCRIPT_BEGIN(frame);
+
+		if (shotsPerSecond == 0)
+			SCRIPT_STOP(frame);
+
+		while (true)
+		{
+			SCRIPT_WAIT_UNTIL(frame, tick, frame.mark + ticksPerSecond/shotsPerSecond + 1);
+
+			SCRIPT_WAIT_SIGHT(frame);
+
+			frame.mark = tick;
+
+			for (frame.count = 1; ; ++frame.count)
+			{
+				emitter.volley(position, target, bullets);
+
+				if (frame.count >= emitter.getDescription().volleys)
+					break;
+
+				SCRIPT_WAIT_TICKS(frame, tick, emitter.getDescription().gap);
+			}
+		}
+
+		SCRIPT_END(frame);
+	}
+
+	void draw(sf::RenderTarget & target, sf::RectangleShape & rectangle)
+	{
+		rectangle.setFillColor(sf::Color(255, 255, 0));
+
+		rectangle.setSize(sf::Vector2f(size, size));
+
+		rectangle.setOrigin(rectangle.getSize().x/2, rectangle.getSize().y/2);
+
+		rectangle.setPosition(position);
+
+		target.draw(rectangle);
+	}
+
+	sf::Vector2f getPosition() {return position;}
+
+	int getSize() {return size;}
+
+	int getShotsPerSecond() {return shotsPerSecond;}
+
+	bool operator==(const Turret & other) {return position == other.position && shotsPerSecond == other.shotsPerSecond;}
+};
+
+//moving turrets bucketed by the cell their centre is in, so the ones near a
+//point are found by looking through the few cells around it and no others.
+//Each cell's turrets are a doubly linked list, so a turret only has to be
+//relinked on the rare moves that take it into another cell
+class CrowdGrid
+{
+	//at least as big as anything looked for around a turret
+	static const int cellSize = 32;
+	static const std::int32_t none = -1;
+
+	sf::Vector2i size;
+
+	std::vector<std::int32_t> heads;
+
+	//by turret
+	std::vector<sf::Vector2f> positions;
+	std::vector<std::int32_t> cells;
+	std::vector<std::int32_t> next;
+	std::vector<std::int32_t> previous;
+
+	sf::Vector2i cellAt(sf::Vector2f position)
+	{
+		return sf::Vector2i(std::max(0, std::min(size.x - 1, static_cast<int> (position.x)/cellSize)), std::max(0, std::min(size.y - 1, static_cast<int> (position.y)/cellSize)));
+	}
+
+	void link(std::uint32_t index, std::int32_t cell)
+	{
+		cells[index] = cell;
+		previous[index] = none;
+		next[index] = heads[cell];
+
+		if (heads[cell] != none)
+			previous[heads[cell]] = index;
+
+		heads[cell] = index;
+	}
+
+	void unlink(std::uint32_t index)
+	{
+		if (next[index] != none)
+			previous[next[index]] = previous[index];
+
+		if (previous[index] != none)
+			next[previous[index]] = next[index];
+		else
+			heads[cells[index]] = next[index];
+	}
+
+public:
+	CrowdGrid() : size(0, 0) {}
+
+	//empties it for count turrets on a level pixels across
+	void reset(sf::Vector2i pixels, std::size_t count)
+	{
+		size = sf::Vector2i((pixels.x + cellSize - 1)/cellSize, (pixels.y + cellSize - 1)/cellSize);
+
+		heads.assign(size.x*size.y, none);
+
+		positions.resize(count);
+		cells.resize(count);
+		next.resize(count);
+		previous.resize(count);
+	}
+
+	void place(std::uint32_t index, sf::Vector2f position)
+	{
+		sf::Vector2i cell = cellAt(position);
+
+		positions[index] = position;
+
+		link(index, cell.y*size.x + cell.x);
+	}
+
+	void move(std::uint32_t index, sf::Vector2f position)
+	{
+		sf::Vector2i cell = cellAt(position);
+
+		positions[index] = position;
+
+		if (cell.y*size.x + cell.x != cells[index])
+		{
+			unlink(index);
+
+			link(index, cell.y*size.x + cell.x);
+		}
+	}
+
+	//calls visit with the index and position of every turret but index whose
+	//centre is less than radius from position along both axes
+	template <typename Visit> void forEachNear(std::uint32_t index, sf::Vector2f position, float radius, Visit visit)
+	{
+		sf::Vector2i low = cellAt(position - sf::Vector2f(radius, radius));
+		sf::Vector2i high = cellAt(position + sf::Vector2f(radius, radius));
+
+		for (int y = low.y; y <= high.y; ++y)
+			for (int x = low.x; x <= high.x; ++x)
+				for (std::int32_t other = heads[y*size.x + x]; other != none; other = next[other])
+					if (static_cast<std::uint32_t> (other) != index && std::abs(positions[other].x - position.x) < radius && std::abs(positions[other].y - position.y) < radius)
+						visit(static_cast<std::uint32_t> (other), positions[other]);
+	}
+
+	//which way to edge away from the turrets within radius of index, one
+	//count a side for each of them. Turrets on exactly the same spot are
+	//split by their order, so the push does not depend on the order they are found in
+	sf::Vector2i separation(std::uint32_t index, float radius)
+	{
+		sf::Vector2i push(0, 0);
+
+		sf::Vector2f position = positions[index];
+
+		forEachNear(index, position, radius, [&](std::uint32_t other, sf::Vector2f near)
+		{
+			if (near == position)
+				push.x += (other < index ? 1 : -1);
+			else
+			{
+				push.x += sign(position.x - near.x);
+				push.y += sign(position.y - near.y);
+			}
+		});
+
+		return push;
+	}
+
+	//whether moving index from from to to would make it overlap a turret it
+	//did not overlap already, turrets being squares size across. Turrets that
+	//already overlap are left free to move apart
+	bool isBlocked(std::uint32_t index, sf::Vector2f from, sf::Vector2f to, int size)
+	{
+		bool blocked = false;
+
+		forEachNear(index, to, size, [&](std::uint32_t, sf::Vector2f near)
+		{
+			if (!(std::abs(near.x - from.x) < size && std::abs(near.y - from.y) < size))
+				blocked = true;
+		});
+
+		return blocked;
+	}
+
+	std::size_t getMemory()
+	{
+		return heads.capacity()*sizeof(std::int32_t) + positions.capacity()*sizeof(sf::Vector2f) + (cells.capacity() + next.capacity() + previous.capacity())*sizeof(std::int32_t);
+	}
+};
+
+const int CrowdGrid::cellSize;
+const std::int32_t CrowdGrid::none;
+
+class MovingTurret
+{
+	float speed;
+
+	sf::Vector2f position;
+
+	int size;
+	int shotsPerSecond;
+	
+	bool canShoot;
+
+	std::uint32_t lastShotTick;
+
+	//when it was last updated either way, and how far it may still move
+	//coarsely before it has to wait for more time to pass
+	std::uint32_t lastUpdateTick;
+	float travel;
+
+	//whether it could see its target at its last full update
+	bool sawTarget;
+
+	Emitter emitter;
+
+	//where it is in the game's CrowdGrid, when there is one
+	std::uint32_t crowdIndex;
+
+	bool isOpen(sf::Vector2i tile, BlockGrid & grid)
+	{
+		return tile.x >= 0 && tile.y >= 0 && tile.x < grid.getSize().x && tile.y < grid.getSize().y && !grid.isSolid(tile.x, tile.y);
+	}
+
+public:
+	MovingTurret(sf::Vector2f position, float speed, int shotsPerSecond) : position(position), speed(speed), shotsPerSecond(shotsPerSecond), canShoot(false), size(10), lastShotTick(0), lastUpdateTick(0), travel(0), sawTarget(false), crowdIndex(0)
+	{
+
+	}
+
+	void setPattern(int pattern) {emitter = Emitter(pattern);}
+
+	void setCrowdIndex(std::uint32_t index) {crowdIndex = index;}
+
+	//with a crowd the turret keeps its distance from other moving turrets and
+	//never moves into one
+	void update(sf::Vector2f target, bool hasLineOfSight, BulletStore & bullets, BlockGrid & grid, std::uint32_t tick, CrowdGrid * crowd = nullptr)
+	{
+		lastUpdateTick = tick;
+		travel = 0;
+		sawTarget = hasLineOfSight;
+
+		if (target == sf::Vector2f(0, 0))
+			return;
+
+		if (canShoot && hasLineOfSight)
+		{
+			canShoot = false;
+
+			lastShotTick = tick;
+
+			emitter.fire(tick);
+		}
+
+		emitter.update(position, target, bullets, tick);
+
+		if (!canShoot && shotsPerSecond != 0)
+		{
+			if (tick - lastShotTick > static_cast<std::uint32_t> (ticksPerSecond/shotsPerSecond))
+				canShoot = true;
+		}
+
+		bool chasing = !(distance(position, target) < 100 && hasLineOfSight);
+
+		if (chasing || crowd != nullptr)
+		{
+			sf::Vector2f cornerPosition;
+
+			cornerPosition.x = position.x - size/2;
+			cornerPosition.y = position.y - size/2;
+
+			int xMove = chasing ? target.x - position.x : 0;
+			int yMove = chasing ? target.y - position.y : 0;
+
+			if (std::abs(xMove) > speed)
+				xMove = xMove > 0 ? speed : -speed;
+
+			if (std::abs(yMove) > speed)
+				yMove = yMove > 0 ? speed : -speed;
+
+			//edging away from close turrets never makes it faster than it chases
+			if (crowd != nullptr)
+			{
+				sf::Vector2i push = crowd->separation(crowdIndex, 2*size);
+
+				int most = std::max(1, static_cast<int> (speed));
+
+				xMove = std::max(-most, std::min(most, xMove + sign(push.x)));
+				yMove = std::max(-most, std::min(most, yMove + sign(push.y)));
+			}
+
+			int prevX = position.x;
+			int prevY = position.y;
+
+			for (int i = 0; i < std::abs(xMove); ++i)
+			{
+				int increment = sign(xMove);
+
+				sf::Vector2f before = position;
+
+				position.x += increment;
+
+				sf::Vector2i blocks[4] =
+				{
+					sf::Vector2i((position.x - size/2)/grid.getBlockSize(), (position.y - size/2)/grid.getBlockSize()),
+					sf::Vector2i(std::ceil((position.x + size/2) /grid.getBlockSize()), std::ceil((position.y + size/2)/grid.getBlockSize())),
+					sf::Vector2i(std::ceil((position.x + size/2)/grid.getBlockSize()), (position.y - size/2)/grid.getBlockSize()),
+					sf::Vector2i((position.x - size/2)/grid.getBlockSize(), std::ceil((position.y + size/2)/grid.getBlockSize()))
+				};
+
+				if (position.x < 0 || position.x > grid.getBlockSize()*grid.getSize().x - size || (crowd != nullptr && crowd->isBlocked(crowdIndex, before, position, size)))
+				{
+					position.x = prevX;
+
+					break;
+				}
+
+				for (auto block : blocks)
+					if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
+					{
+						position.x = prevX;
+
+						break;
+					}
+
+				prevX = position.x;
+			}
+
+			for (int i = 0; i < std::abs(yMove); ++i)
+			{
+				int increment = sign(yMove);
+
+				sf::Vector2f before = position;
+
+				position.y += increment;
+
+				sf::Vector2i blocks[4] =
+				{
+					sf::Vector2i((position.x - size/2)/grid.getBlockSize(), (position.y - size/2)/grid.getBlockSize()),
+					sf::Vector2i(std::ceil((position.x + size/2) /grid.getBlockSize()), std::ceil((position.y + size/2)/grid.getBlockSize())),
+					sf::Vector2i(std::ceil((position.x + size/2)/grid.getBlockSize()), (position.y - size/2)/grid.getBlockSize()),
+					sf::Vector2i((position.x - size/2)/grid.getBlockSize(), std::ceil((position.y + size/2)/grid.getBlockSize()))
+				};
+
+				if (position.y < 0 || position.y > grid.getBlockSize()*grid.getSize().y - size || (crowd != nullptr && crowd->isBlocked(crowdIndex, before, position, size)))
+				{
+					position.y = prevY;
+
+					break;
+				}
+
+				for (auto block : blocks)
+					if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
+					{
+						position.y = prevY;
+
+						break;
+					}
+
+				prevY = position.y;
+			}
+
+			/*position = cornerPosition;
+
+			int extra = (size/2) % 2 == 0 ? 0 : 1;
+
+			position.x += size/2 + extra;
+			position.y += size/2 + extra;*/
+
+			if (crowd != nullptr)
+				crowd->move(crowdIndex, position);
+		}
+	}
+
+	//heads for target from tile centre to tile centre, taking a diagonal step
+	//only where both tiles beside it are open and stepping sideways where a
+	//wall is in the way. Time since the last update, up
+	//to maxElapsed ticks so a turret waking up does not leap, adds to travel
+	//at the turret's speed, and each tile moved spends a tile of it. With a
+	//crowd, tiles it would overlap another turret in count as closed
+	void coarseUpdate(sf::Vector2f target, BlockGrid & grid, std::uint32_t tick, std::uint32_t maxElapsed, CrowdGrid * crowd = nullptr)
+	{
+		travel += speed*std::min(tick - lastUpdateTick, maxElapsed);
+
+		lastUpdateTick = tick;
+
+		const int blockSize = grid.getBlockSize();
+
+		sf::Vector2i goal(std::floor(target.x/blockSize), std::floor(target.y/blockSize));
+
+		while (travel >= blockSize)
+		{
+			sf::Vector2i tile(std::floor(position.x/blockSize), std::floor(position.y/blockSize));
+			sf::Vector2i toward(sign(goal.x - tile.x), sign(goal.y - tile.y));
+
+			if (toward == sf::Vector2i(0, 0))
+				break;
+
+			//straight at the goal, then along each axis, then at right angles to
+			//the goal either way to slide along a wall
+			sf::Vector2i steps[] = {toward, sf::Vector2i(toward.x, 0), sf::Vector2i(0, toward.y), sf::Vector2i(-toward.y, toward.x), sf::Vector2i(toward.y, -toward.x)};
+
+			sf::Vector2i step(0, 0);
+
+			auto centre = [&](sf::Vector2i tile) {return sf::Vector2f(tile.x*blockSize + blockSize/2, tile.y*blockSize + blockSize/2);};
+
+			for (sf::Vector2i option : steps)
+				if (option != sf::Vector2i(0, 0) && isOpen(tile + option, grid) && (option.x == 0 || option.y == 0 || (isOpen(tile + sf::Vector2i(option.x, 0), grid) && isOpen(tile + sf::Vector2i(0, option.y), grid))) && (crowd == nullptr || !crowd->isBlocked(crowdIndex, position, centre(tile + option), size)))
+				{
+					step = option;
+
+					break;
+				}
+
+			if (step == sf::Vector2i(0, 0))
+			{
+				travel = 0;
+
+				break;
+			}
+
+			tile += step;
+
+			position = centre(tile);
+
+			travel -= blockSize;
+
+			if (crowd != nullptr)
+				crowd->move(crowdIndex, position);
+		}
+	}
+
+	std::uint32_t getLastUpdateTick() {return lastUpdateTick;}
+
+	bool getSawTarget() {return sawTarget;}
+
+	void draw(sf::RenderTarget & target, sf::RectangleShape & rectangle)
+	{
+		rectangle.setFillColor(sf::Color::Green);
+
+		rectangle.setSize(sf::Vector2f(size, size));
+
+		rectangle.setPosition(position);
+
+		rectangle.setOrigin(rectangle.getSize().x/2, rectangle.getSize().y/2);
+
+		target.draw(rectangle);
+	}
+
+	sf::Vector2f getPosition() {return position;}
+
+	int getSize() {return size;}
+
+	float getSpeed() {return speed;}
+
+	int getShotsPerSecond() {return shotsPerSecond;}
+};
+
+class MovingSpawningTurret
+{
+	float speed;
+	float spawnTime;
+
+	sf::Vector2f position;
+
+	int size;
+	int shotsPerSecond;
+	
+	bool canShoot;
+
+	std::uint32_t lastShotTick;
+	std::uint32_t lastSpawnTick;
+
+	Emitter emitter;
+
+public:
+	MovingSpawningTurret(sf::Vector2f position, float speed, float spawnTime, int shotsPerSecond, std::uint32_t tick) : position(position), speed(speed), spawnTime(spawnTime), shotsPerSecond(shotsPerSecond), canShoot(false), size(10), lastShotTick(tick), lastSpawnTick(tick)
+	{
+
+	}
+
+	void update(sf::Vector2f target, std::vector<MovingSpawningTurret> & turrets, BulletStore & bullets, BlockGrid & grid, Random & random, std::uint32_t tick)
+	{
+		if (target == sf::Vector2f(0, 0))
+			return;
+
+		bool hasLineOfSight = lineOfSight(position, target, grid);
+
+		if (canShoot && hasLineOfSight)
+		{
+			canShoot = false;
+
+			lastShotTick = tick;
+
+			emitter.fire(tick);
+		}
+
+		emitter.update(position, target, bullets, tick);
+
+		if (!canShoot && shotsPerSecond != 0)
+		{
+			if (tick - lastShotTick > static_cast<std::uint32_t> (ticksPerSecond/shotsPerSecond))
+				canShoot = true;
+		}
+
+		if (tick - lastSpawnTick > spawnTime*ticksPerSecond)
+		{
+			lastSpawnTick = tick;
+
+			int leftBound = (position.x - 100)/grid.getBlockSize();
+			int topBound = (position.y - 100)/grid.getBlockSize();
+			int rightBound = (position.x + std::ceil(100))/grid.getBlockSize();
+			int bottomBound = (position.y + std::ceil(100))/grid.getBlockSize();
+
+			if (leftBound < 0)
+				leftBound = 0;
+
+			if (rightBound >= grid.getSize().x)
+				rightBound = grid.getSize().x - 2;
+
+			if (topBound < 0)
+				topBound = 0;
+
+			if (bottomBound >= grid.getSize().y)
+				bottomBound = grid.getSize().y - 1;
+
+			int emptyCount = grid.countEmpty(leftBound, topBound, rightBound, bottomBound);
+
+			if (emptyCount > 0)
+			{
+				sf::Vector2i block = grid.findEmpty(leftBound, topBound, rightBound, bottomBound, random.nextInt(emptyCount));
+
+				sf::Vector2f position(block.x*grid.getBlockSize() + grid.getBlockSize()/2, block.y*grid.getBlockSize() + grid.getBlockSize()/2);
+
+				turrets.push_back(MovingSpawningTurret(position, 1, 1, 1, tick));
+			}
+		}
+
+		if (!(distance(position, target) < 100 && hasLineOfSight))
+		{
+			sf::Vector2f cornerPosition;
+
+			cornerPosition.x = position.x - size/2;
+			cornerPosition.y = position.y - size/2;
+
+			int xMove = target.x - position.x;
+			int yMove = target.y - position.y;
+
+			if (std::abs(xMove) > speed)
+				xMove = xMove > 0 ? speed : -speed;
+
+			if (std::abs(yMove) > speed)
+				yMove = yMove > 0 ? speed : -speed;
+
+			int prevX = position.x;
+			int prevY = position.y;
+
+			for (int i = 0; i < std::abs(xMove); ++i)
+			{
+				int increment = sign(xMove);
+
+				position.x += increment;
+
+				sf::Vector2i blocks[4] =
+				{
+					sf::Vector2i((position.x - size/2)/grid.getBlockSize(), (position.y - size/2)/grid.getBlockSize()),
+					sf::Vector2i(std::ceil((position.x + size/2) /grid.getBlockSize()), std::ceil((position.y + size/2)/grid.getBlockSize())),
+					sf::Vector2i(std::ceil((position.x + size/2)/grid.getBlockSize()), (position.y - size/2)/grid.getBlockSize()),
+					sf::Vector2i((position.x - size/2)/grid.getBlockSize(), std::ceil((position.y + size/2)/grid.getBlockSize()))
+				};
+
+				if (position.x < 0 || position.x > grid.getBlockSize()*grid.getSize().x - size)
+				{
+					position.x = prevX;
+
+					break;
+				}
+
+				for (auto block : blocks)
+					if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
+					{
+						position.x = prevX;
+
+						break;
+					}
+
+				prevX = position.x;
+			}
+
+			for (int i = 0; i < std::abs(yMove); ++i)
+			{
+				int increment = sign(yMove);
+
+				position.y += increment;
+
+				sf::Vector2i blocks[4] =
+				{
+					sf::Vector2i((position.x - size/2)/grid.getBlockSize(), (position.y - size/2)/grid.getBlockSize()),
+					sf::Vector2i(std::ceil((position.x + size/2) /grid.getBlockSize()), std::ceil((position.y + size/2)/grid.getBlockSize())),
+					sf::Vector2i(std::ceil((position.x + size/2)/grid.getBlockSize()), (position.y - size/2)/grid.getBlockSize()),
+					sf::Vector2i((position.x - size/2)/grid.getBlockSize(), std::ceil((position.y + size/2)/grid.getBlockSize()))
+				};
+
+				if (position.y < 0 || position.y > grid.getBlockSize()*grid.getSize().y - size)
+				{
+					position.y = prevY;
+
+					break;
+				}
 
 				for (auto block : blocks)
 					if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
 					{
-						position.x = prevX;
+						position.y = prevY;
+
+						break;
+					}
+
+				prevY = position.y;
+			}
+
+			/*position = cornerPosition;
+
+			int extra = (size/2) % 2 == 0 ? 0 : 1;
+
+			position.x += size/2 + extra;
+			position.y += size/2 + extra;*/
+		}
+	}
+
+	void draw(sf::RenderTarget & target, sf::RectangleShape & rectangle)
+	{
+		rectangle.setFillColor(sf::Color::Magenta);
+
+		rectangle.setSize(sf::Vector2f(size, size));
+
+		rectangle.setPosition(position);
+
+		rectangle.setOrigin(rectangle.getSize().x/2, rectangle.getSize().y/2);
+
+		target.draw(rectangle);
+	}
+
+	sf::Vector2f getPosition() {return position;}
+
+	int getSize() {return size;}
+};
+
+enum InputKey
+{
+	InputLeft = 1 << 0,
+	InputRight = 1 << 1,
+	InputUp = 1 << 2,
+	InputDown = 1 << 3,
+	InputRestart = 1 << 4,
+
+	//the frame governor's level, kept with the keys so that recordings play
+	//back with the same fidelity they were played with
+	InputGovernor = 7 << 5
+};
+
+const int inputGovernorShift = 5;
+
+//what a game gives up when its frames run over budget, in the order it gives
+//it up. Each level also gives up everything the levels below it do
+enum GovernorLevel
+{
+	GovernorFull,
+	//bullets off screen are not drawn
+	GovernorCullBullets,
+	//each turret looks for the player every other tick, going on what it saw
+	//the tick before in between
+	GovernorStaleSight,
+	//only a few bullets are fired each tick, the rest of the shots are dropped
+	GovernorCapSpawns,
+	//moving turrets off screen are only moved from a quarter as far away
+	GovernorShrinkMargin,
+	GovernorLevelCount
+};
+
+static_assert(GovernorLevelCount - 1 <= InputGovernor >> inputGovernorShift, "governor levels must fit in the input");
+
+const std::uint32_t governedSpawnsPerTick = 4;
+
+//picks the level a game plays at from how long its frames take. Frame times
+//are smoothed, the level goes up a step when they come close to the budget and
+//down a step when there is plenty of room, and each change holds for a while
+//so the level does not flap
+class FrameGovernor
+{
+	//microseconds, zero to stay at full fidelity
+	float budget;
+	float average;
+
+	int level;
+	int hold;
+
+public:
+	FrameGovernor(float budgetMilliseconds) : budget(budgetMilliseconds*1000), average(0), level(GovernorFull), hold(0) {}
+
+	void record(float microseconds)
+	{
+		if (budget <= 0)
+			return;
+
+		average += (microseconds - average)/8;
+
+		if (hold > 0)
+			--hold;
+		else if (average > budget*0.9f && level < GovernorLevelCount - 1)
+		{
+			++level;
+
+			hold = ticksPerSecond/4;
+		}
+		else if (average < budget*0.5f && level > GovernorFull)
+		{
+			--level;
+
+			hold = ticksPerSecond;
+		}
+	}
+
+	int getLevel() {return level;}
+};
+
+std::uint8_t readInput()
+{
+	std::uint8_t input = 0;
+
+	if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left) || sf::Keyboard::isKeyPressed(sf::Keyboard::A))
+		input |= InputLeft;
+
+	if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right) || sf::Keyboard::isKeyPressed(sf::Keyboard::D))
+		input |= InputRight;
+
+	if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up) || sf::Keyboard::isKeyPressed(sf::Keyboard::W))
+		input |= InputUp;
+
+	if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down) || sf::Keyboard::isKeyPressed(sf::Keyboard::S))
+		input |= InputDown;
+
+	if (sf::Keyboard::isKeyPressed(sf::Keyboard::R))
+		input |= InputRestart;
+
+	return input;
+}
+
+class Player
+{
+	sf::Vector2f position;
+
+	int size;
+
+public:
+	Player() : position(0, 0), size(25) {}
+
+	template <typename Grid>
+	void update(Grid & grid, std::uint8_t input)
+	{
+		int xMove = 0;
+		int yMove = 0;
+
+		int prevX = position.x;
+		int prevY = position.y;
+
+		int moveAmount = 3;
+
+		if (input & InputLeft)
+			xMove = -moveAmount;
+
+		if (input & InputRight)
+			xMove = moveAmount;
+
+		if (input & InputUp)
+			yMove = -moveAmount;
+
+		if (input & InputDown)
+			yMove = moveAmount;
+
+		//nothing solid within two blocks of the one the corner is in means no
+		//wall can stop the move, so only the level edges need checking
+		if (grid.getDistance(position.x/grid.getBlockSize(), position.y/grid.getBlockSize()) > 2)
+		{
+			sf::Vector2f moved(position.x + xMove, position.y + yMove);
+
+			if (moved.x >= 0 && moved.x <= grid.getBlockSize()*grid.getSize().x - size && moved.y >= 0 && moved.y <= grid.getBlockSize()*grid.getSize().y - size)
+			{
+				position = moved;
+
+				return;
+			}
+		}
+
+		for (int i = 0; i < std::abs(xMove); ++i)
+		{
+			int increment = sign(xMove);
+
+			position.x += increment;
+
+			sf::Vector2i blocks[4] =
+			{
+				sf::Vector2i(position.x/grid.getBlockSize(), position.y/grid.getBlockSize()),
+				sf::Vector2i(std::ceil(position.x/grid.getBlockSize()), std::ceil(position.y/grid.getBlockSize())),
+				sf::Vector2i(std::ceil(position.x/grid.getBlockSize()), position.y/grid.getBlockSize()),
+				sf::Vector2i(position.x/grid.getBlockSize(), std::ceil(position.y/grid.getBlockSize()))
+			};
+
+			if (position.x < 0 || position.x > grid.getBlockSize()*grid.getSize().x - size)
+			{
+				position.x = prevX;
+
+				break;
+			}
+
+			//with tiles bigger than the player its far corner can round up past the level
+			//edge, so blocks outside the grid are skipped as the turrets skip them
+			for (auto block : blocks)
+				if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
+				{
+					position.x = prevX;
+
+					break;
+				}
+
+			prevX = position.x;
+		}
+
+		for (int i = 0; i < std::abs(yMove); ++i)
+		{
+			int increment = sign(yMove);
+
+			position.y += increment;
+
+			sf::Vector2i blocks[4] =
+			{
+				sf::Vector2i(position.x/grid.getBlockSize(), position.y/grid.getBlockSize()),
+				sf::Vector2i(std::ceil(position.x/grid.getBlockSize()), std::ceil(position.y/grid.getBlockSize())),
+				sf::Vector2i(std::ceil(position.x/grid.getBlockSize()), position.y/grid.getBlockSize()),
+				sf::Vector2i(position.x/grid.getBlockSize(), std::ceil(position.y/grid.getBlockSize()))
+			};
+
+			if (position.y < 0 || position.y > grid.getBlockSize()*grid.getSize().y - size)
+			{
+				position.y = prevY;
+
+				break;
+			}
+
+			for (auto block : blocks)
+				if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
+				{
+					position.y = prevY;
+
+					break;
+				}
+
+			prevY = position.y;
+		}
+	}
+
+	void draw(sf::RenderTarget & target, sf::RectangleShape & rectangle)
+	{
+		rectangle.setFillColor(sf::Color::Red);
+
+		rectangle.setSize(sf::Vector2f(size, size));
+
+		rectangle.setOrigin(0, 0);
+
+		rectangle.setPosition(position);
+
+		target.draw(rectangle);
+	}
+
+	int getSize() {return size;}
+
+	sf::Vector2f getPosition() {return position;}
+};
+
+	
+
+float pointDirection(sf::Vector2f looker, sf::Vector2f target)
+{
+	return 3.12 + std::atan2(looker.y - target.y, looker.x - target.x);
+}
+
+float distance(sf::Vector2f point1, sf::Vector2f point2)
+{
+	return std::sqrt(std::pow(point1.x - point2.x, 2) + std::pow(point1.y - point2.y, 2));
+}
+
+//whether the bullet touches the player at any point in a tick that the player
+//started at playerStart, with the bullet getting through travel of its last step.
+//Both move, so the bullet's path is taken relative to the player
+bool playerBulletCollision(sf::Vector2f playerStart, Player player, Bullet bullet, float travel)
+{
+	sf::Vector2f playerEnd = playerStart + (player.getPosition() - playerStart)*travel;
+	sf::Vector2f bulletEnd = bullet.getPreviousPosition() + (bullet.getPosition() - bullet.getPreviousPosition())*travel;
+
+	float half = bullet.getSize()/2.f;
+
+	sf::FloatRect playerRect(-half, -half, player.getSize() + bullet.getSize(), player.getSize() + bullet.getSize());
+
+	return sweepPointBox(bullet.getPreviousPosition() - playerStart, bulletEnd - playerEnd, playerRect) >= 0;
+}
+
+template <typename T> int sign(T val) {
+    return (T(0) < val) - (val < T(0));
+}
+
+//how many empty blocks to pass over before the next to get a turret, when each
+//gets one with odds of one in oneIn, and at most limit
+int skipBlocks(Random & random, int oneIn, int limit)
+{
+	if (oneIn <= 1)
+		return 0;
+
+	//nextFloat can return 1, whose log is infinite
+	float skip = std::floor(std::log(1 - std::min(random.nextFloat(), std::nextafter(1.f, 0.f)))/std::log(1 - 1.f/oneIn));
+
+	return skip >= 0 && skip < limit ? static_cast<int> (skip) : limit;
+}
+
+void populateTurrets(std::vector<Turret> & turrets, BlockGrid & grid, Random & random, int oneIn = 65)
+{
+	TRACE_SCOPE("populateTurrets");
+
+	int emptyCount = grid.countEmpty(0, 0, grid.getSize().x, grid.getSize().y);
+
+	for (int index = skipBlocks(random, oneIn, emptyCount); index < emptyCount; index += 1 + skipBlocks(random, oneIn, emptyCount - index))
+	{
+		sf::Vector2i block = grid.findEmpty(0, 0, grid.getSize().x, grid.getSize().y, index);
+
+		//searching the whole grid keeps every pyramid node inside it, so lookups go
+		//straight down. Picks in the start and end zones are dropped, which leaves
+		//the odds for every other block the same
+		if (block.x < 3 || block.x >= grid.getSize().x - 4)
+			continue;
+
+		turrets.push_back(Turret(sf::Vector2f(block.x*grid.getBlockSize() + grid.getBlockSize()/2, block.y*grid.getBlockSize() + grid.getBlockSize()/2), 1));
+	}
+}
+
+void populateMovingTurrets(std::vector<MovingTurret> & turrets, BlockGrid & grid, Random & random, int oneIn = 501)
+{
+	TRACE_SCOPE("populateMovingTurrets");
+
+	int emptyCount = grid.countEmpty(0, 0, grid.getSize().x, grid.getSize().y);
+
+	for (int index = skipBlocks(random, oneIn, emptyCount); index < emptyCount; index += 1 + skipBlocks(random, oneIn, emptyCount - index))
+	{
+		sf::Vector2i block = grid.findEmpty(0, 0, grid.getSize().x, grid.getSize().y, index);
+
+		//picks in the start and end zones are dropped, as in populateTurrets
+		if (block.x < 3 || block.x >= grid.getSize().x - 4)
+			continue;
+
+		turrets.push_back(MovingTurret(sf::Vector2f(block.x*grid.getBlockSize() + grid.getBlockSize()/2, block.y*grid.getBlockSize() + grid.getBlockSize()/2), 1, 1));
+	}
+}
+
+void populateMovingSpawningTurrets(std::vector<MovingSpawningTurret> & turrets, BlockGrid & grid, Random & random, int oneIn = 501)
+{
+	TRACE_SCOPE("populateMovingSpawningTurrets");
+
+	int emptyCount = grid.countEmpty(0, 0, grid.getSize().x, grid.getSize().y);
+
+	for (int index = skipBlocks(random, oneIn, emptyCount); index < emptyCount; index += 1 + skipBlocks(random, oneIn, emptyCount - index))
+	{
+		sf::Vector2i block = grid.findEmpty(0, 0, grid.getSize().x, grid.getSize().y, index);
+
+		//picks in the start and end zones are dropped, as in populateTurrets
+		if (block.x < 3 || block.x >= grid.getSize().x - 4)
+			continue;
+
+		turrets.push_back(MovingSpawningTurret(sf::Vector2f(block.x*grid.getBlockSize() + grid.getBlockSize()/2, block.y*grid.getBlockSize() + grid.getBlockSize()/2), 1, 1, 1, 0));
+	}
+}
+
+//whether the line between the points misses every solid block. It sphere traces
+//through the distance field, jumping as far as the nearest wall allows, and goes
+//block by block only where it passes right next to walls
+template <typename Grid>
+bool lineOfSight(sf::Vector2f point1, sf::Vector2f point2, Grid & grid)
+{
+	PROFILE_COUNT(CounterRays, 1);
+
+	const float blockSize = grid.getBlockSize();
+
+	float length = distance(point1, point2);
+
+	if (length == 0)
+		return true;
+
+	sf::Vector2f direction = (point2 - point1)/length;
+
+	float distanceWalked = 0;
+
+	while (distanceWalked < length)
+	{
+		sf::Vector2f position = point1 + direction*distanceWalked;
+
+		int x = std::floor(position.x/blockSize);
+		int y = std::floor(position.y/blockSize);
+
+		int wallDistance = grid.getDistance(x, y);
+
+		if (wallDistance == 0)
+			return false;
+
+		if (wallDistance > 1)
+		{
+			distanceWalked += (wallDistance - 1)*blockSize;
+
+			continue;
+		}
+
+		//step just past the edge of this block the line leaves through first
+		float exitX = (direction.x > 0 ? ((x + 1)*blockSize - position.x)/direction.x : direction.x < 0 ? (x*blockSize - position.x)/direction.x : length);
+		float exitY = (direction.y > 0 ? ((y + 1)*blockSize - position.y)/direction.y : direction.y < 0 ? (y*blockSize - position.y)/direction.y : length);
+
+		distanceWalked += std::min(exitX, exitY) + 0.01f;
+	}
+
+	return true;
+}
+
+#ifdef LINE_OF_SIGHT_AVX2
+//lineOfSight for eight rays at once, one to a lane. Each lane does the same
+//float operations in the same order as lineOfSight, so it gives exactly the
+//same answers. Lanes stop as their rays finish, and a group ends when all of
+//its lanes have. Returns how many rays it did, a multiple of eight
+__attribute__((target("avx2")))
+std::size_t lineOfSightAvx2(const sf::Vector2f * from, std::size_t count, sf::Vector2f to, const std::uint8_t * distances, sf::Vector2i size, float blockSize, int maxDistance, std::uint8_t * visible)
+{
+	const __m256 block = _mm256_set1_ps(blockSize);
+	const __m256 step = _mm256_set1_ps(0.01f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256i width = _mm256_set1_epi32(size.x);
+	const __m256i height = _mm256_set1_epi32(size.y);
+	const __m256i far = _mm256_set1_epi32(maxDistance);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i lowByte = _mm256_set1_epi32(0xff);
+
+	std::size_t done = 0;
+
+	for (; done + 8 <= count; done += 8)
+	{
+		alignas(32) float startX[8];
+		alignas(32) float startY[8];
+		alignas(32) float directionX[8];
+		alignas(32) float directionY[8];
+		alignas(32) float lengths[8];
+
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			float length = distance(from[done + lane], to);
+
+			sf::Vector2f direction = (length == 0 ? sf::Vector2f(0, 0) : (to - from[done + lane])/length);
+
+			startX[lane] = from[done + lane].x;
+			startY[lane] = from[done + lane].y;
+			directionX[lane] = direction.x;
+			directionY[lane] = direction.y;
+			lengths[lane] = length;
+		}
+
+		const __m256 x1 = _mm256_load_ps(startX);
+		const __m256 y1 = _mm256_load_ps(startY);
+		const __m256 dx = _mm256_load_ps(directionX);
+		const __m256 dy = _mm256_load_ps(directionY);
+		const __m256 length = _mm256_load_ps(lengths);
+
+		const __m256 rightward = _mm256_cmp_ps(dx, zero, _CMP_GT_OQ);
+		const __m256 leftward = _mm256_cmp_ps(dx, zero, _CMP_LT_OQ);
+		const __m256 downward = _mm256_cmp_ps(dy, zero, _CMP_GT_OQ);
+		const __m256 upward = _mm256_cmp_ps(dy, zero, _CMP_LT_OQ);
+
+		__m256 walked = zero;
+		__m256 active = _mm256_cmp_ps(walked, length, _CMP_LT_OQ);
+		__m256 blocked = zero;
+
+		while (_mm256_movemask_ps(active))
+		{
+			__m256 positionX = _mm256_add_ps(x1, _mm256_mul_ps(dx, walked));
+			__m256 positionY = _mm256_add_ps(y1, _mm256_mul_ps(dy, walked));
+
+			__m256i x = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(positionX, block)));
+			__m256i y = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(positionY, block)));
+
+			//blocks outside the grid read as maxDistance without being looked up
+			__m256i inside = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), x), _mm256_cmpgt_epi32(_mm256_setzero_si256(), y)),
+				_mm256_and_si256(_mm256_cmpgt_epi32(width, x), _mm256_cmpgt_epi32(height, y)));
+
+			__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(x, height), y);
+
+			__m256i wallDistance = _mm256_and_si256(_mm256_mask_i32gather_epi32(far, reinterpret_cast<const int *> (distances), index, _mm256_and_si256(inside, _mm256_castps_si256(active)), 1), lowByte);
+
+			__m256 hit = _mm256_and_ps(active, _mm256_castsi256_ps(_mm256_cmpeq_epi32(wallDistance, _mm256_setzero_si256())));
+
+			blocked = _mm256_or_ps(blocked, hit);
+			active = _mm256_andnot_ps(hit, active);
+
+			__m256 jump = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(wallDistance, one)), block);
+
+			__m256 left = _mm256_mul_ps(_mm256_cvtepi32_ps(x), block);
+			__m256 top = _mm256_mul_ps(_mm256_cvtepi32_ps(y), block);
+			__m256 right = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(x, one)), block);
+			__m256 bottom = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(y, one)), block);
+
+			__m256 exitX = _mm256_blendv_ps(_mm256_blendv_ps(length, _mm256_div_ps(_mm256_sub_ps(left, positionX), dx), leftward), _mm256_div_ps(_mm256_sub_ps(right, positionX), dx), rightward);
+			__m256 exitY = _mm256_blendv_ps(_mm256_blendv_ps(length, _mm256_div_ps(_mm256_sub_ps(top, positionY), dy), upward), _mm256_div_ps(_mm256_sub_ps(bottom, positionY), dy), downward);
+
+			//std::min(exitX, exitY) keeps exitX unless exitY is smaller, which is min_ps the other way round
+			__m256 edge = _mm256_add_ps(_mm256_min_ps(exitY, exitX), step);
+
+			__m256 clear = _mm256_castsi256_ps(_mm256_cmpgt_epi32(wallDistance, one));
+
+			walked = _mm256_blendv_ps(walked, _mm256_add_ps(walked, _mm256_blendv_ps(edge, jump, clear)), active);
+
+			active = _mm256_and_ps(active, _mm256_cmp_ps(walked, length, _CMP_LT_OQ));
+		}
+
+		int blockedLanes = _mm256_movemask_ps(blocked);
+
+		for (int lane = 0; lane < 8; ++lane)
+			visible[done + lane] = !((blockedLanes >> lane) & 1);
+	}
+
+	return done;
+}
+#endif
+
+//lineOfSight from each of count points to the same point, written to visible.
+//Rays go through the AVX2 march eight at a time where the CPU has it, and the
+//rest one at a time, with the same answers either way
+template <int TileSize>
+void lineOfSightBatch(const sf::Vector2f * from, std::size_t count, sf::Vector2f to, BasicBlockGrid<TileSize> & grid, std::uint8_t * visible)
+{
+	std::size_t done = 0;
+
+#ifdef LINE_OF_SIGHT_AVX2
+	if (__builtin_cpu_supports("avx2"))
+	{
+		done = lineOfSightAvx2(from, count, to, grid.getDistances(), grid.getSize(), grid.getBlockSize(), grid.maxDistance, visible);
+
+		PROFILE_COUNT(CounterRays, done);
+	}
+#endif
+
+	for (std::size_t i = done; i < count; ++i)
+		visible[i] = lineOfSight(from[i], to, grid);
+}
+
+//level files are laid out so they can be mapped and used in place: a header,
+//then the packed BlockGrid columns and the turret tables, each 8 byte aligned.
+//What is derived from the blocks is not stored, and is rebuilt on loading
+const char levelMagic[4] = {'D', 'B', 'D', 'L'};
+const std::uint32_t levelVersion = 1;
+
+struct LevelHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t seed;
+	std::int32_t width;
+	std::int32_t height;
+	std::int32_t blockSize;
+	std::uint32_t turretCount;
+	std::uint32_t movingTurretCount;
+	std::uint64_t gridOffset;
+	std::uint64_t turretOffset;
+	std::uint64_t movingTurretOffset;
+};
+
+struct LevelTurret
+{
+	float x;
+	float y;
+	std::int32_t shotsPerSecond;
+	std::int32_t padding;
+};
+
+struct LevelMovingTurret
+{
+	float x;
+	float y;
+	float speed;
+	std::int32_t shotsPerSecond;
+};
+
+class Level
+{
+	std::shared_ptr<MappedFile> file;
+
+	const LevelHeader * header;
+
+	bool fits(std::uint64_t offset, std::uint64_t bytes)
+	{
+		return offset % 8 == 0 && offset <= file->getSize() && bytes <= file->getSize() - offset;
+	}
+
+public:
+	Level() : header(nullptr) {}
+
+	bool load(const std::string & path)
+	{
+		file = std::make_shared<MappedFile>();
+
+		if (!file->open(path) || file->getSize() < sizeof(LevelHeader))
+			return false;
+
+		header = reinterpret_cast<const LevelHeader *> (file->getData());
+
+		if (std::memcmp(header->magic, levelMagic, sizeof(levelMagic)) != 0 || header->version != levelVersion)
+			return false;
+
+		if (header->width <= 0 || header->height <= 0 || header->blockSize != BlockGrid::blockSize)
+			return false;
+
+		std::uint64_t gridBytes = std::uint64_t(header->width)*((header->height + 63)/64)*sizeof(std::uint64_t);
+
+		return fits(header->gridOffset, gridBytes) && fits(header->turretOffset, std::uint64_t(header->turretCount)*sizeof(LevelTurret)) &&
+			fits(header->movingTurretOffset, std::uint64_t(header->movingTurretCount)*sizeof(LevelMovingTurret));
+	}
+
+	std::uint32_t getSeed() {return header->seed;}
+
+	sf::Vector2i getSize() {return sf::Vector2i(header->width, header->height);}
+
+	//with Runs storage the blocks are copied out of the file into runs
+	BlockGrid getGrid(BlockStorage blockStorage = BlockStorage::Bits)
+	{
+		return BlockGrid(getSize(), reinterpret_cast<const std::uint64_t *> (file->getData() + header->gridOffset), file, blockStorage);
+	}
+
+	const LevelTurret * getTurrets() {return reinterpret_cast<const LevelTurret *> (file->getData() + header->turretOffset);}
+
+	std::uint32_t getTurretCount() {return header->turretCount;}
+
+	const LevelMovingTurret * getMovingTurrets() {return reinterpret_cast<const LevelMovingTurret *> (file->getData() + header->movingTurretOffset);}
+
+	std::uint32_t getMovingTurretCount() {return header->movingTurretCount;}
+};
+
+sf::Vector2i defaultGridSize(sf::Vector2u windowSize)
+{
+	return sf::Vector2i(100, windowSize.y/20);
+}
+
+//turretDensity scales how many turrets the level gets, 1 is the normal game
+void createLevel(std::uint32_t seed, BlockGrid & grid, std::vector<Turret> & turrets, std::vector<MovingTurret> & movingTurrets, float turretDensity = 1)
+{
+	Random random(seed);
+
+	generate(grid, random);
+
+	populateTurrets(turrets, grid, random, std::max(1, static_cast<int> (65/turretDensity)));
+
+	populateMovingTurrets(movingTurrets, grid, random, std::max(1, static_cast<int> (501/turretDensity)));
+}
+
+bool bakeLevel(const std::string & path, std::uint32_t seed, sf::Vector2i size)
+{
+	BlockGrid grid(size);
+
+	std::vector<Turret> turrets;
+	std::vector<MovingTurret> movingTurrets;
+
+	createLevel(seed, grid, turrets, movingTurrets);
+
+	LevelHeader header;
+
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, levelMagic, sizeof(levelMagic));
+
+	header.version = levelVersion;
+	header.seed = seed;
+	header.width = size.x;
+	header.height = size.y;
+	header.blockSize = grid.getBlockSize();
+	header.turretCount = turrets.size();
+	header.movingTurretCount = movingTurrets.size();
+	header.gridOffset = sizeof(LevelHeader);
+	header.turretOffset = header.gridOffset + std::uint64_t(size.x)*grid.getColumnWords()*sizeof(std::uint64_t);
+	header.movingTurretOffset = header.turretOffset + turrets.size()*sizeof(LevelTurret);
+
+	std::ofstream file(path, std::ios::binary);
+
+	if (!file)
+		return false;
+
+	file.write(reinterpret_cast<const char *> (&header), sizeof(header));
+	file.write(reinterpret_cast<const char *> (grid.getWords()), size.x*grid.getColumnWords()*sizeof(std::uint64_t));
+
+	for (Turret & turret : turrets)
+	{
+		LevelTurret record = {turret.getPosition().x, turret.getPosition().y, turret.getShotsPerSecond(), 0};
+
+		file.write(reinterpret_cast<const char *> (&record), sizeof(record));
+	}
+
+	for (MovingTurret & turret : movingTurrets)
+	{
+		LevelMovingTurret record = {turret.getPosition().x, turret.getPosition().y, turret.getSpeed(), turret.getShotsPerSecond()};
+
+		file.write(reinterpret_cast<const char *> (&record), sizeof(record));
+	}
+
+	return static_cast<bool> (file);
+}
+
+template <typename T> void writeValue(std::ostream & stream, T value)
+{
+	stream.write(reinterpret_cast<const char *> (&value), sizeof(T));
+}
+
+template <typename T> bool readValue(std::istream & stream, T & value)
+{
+	return static_cast<bool> (stream.read(reinterpret_cast<char *> (&value), sizeof(T)));
+}
+
+struct InputRun
+{
+	std::uint8_t input;
+	std::uint32_t length;
+};
+
+//replay files are "DBDR", a version, the level seed, window and grid size, the
+//final tick count and outcome, flags, the SimulationDetail, then the input as
+//(input, tick count) runs
+const char replayMagic[4] = {'D', 'B', 'D', 'R'};
+const std::uint32_t replayVersion = 5;
+
+//replays before version 5 still load and play, but the game has changed under
+//them and they are not expected to end as they were recorded. Since then:
+//- bullets are swept against walls and the player, not tested where they land
+//- line of sight is traced along the exact segment, not sampled every 0.9 pixels
+//- turrets are placed by skipping ahead through the empty blocks, so a seed
+//  lays its turrets out differently
+//- moving turrets off screen sidestep walls at right angles to the player,
+//  where diagonal ones used to step straight towards or away from them
+//- a level with no way across is generated again, so those seeds give a
+//  different level and turrets
+const std::uint32_t exactReplayVersion = 5;
+
+//set in the flags of version 3 replays and later
+const std::uint8_t replayDestructible = 1;
+const std::uint8_t replayPatterns = 2;
+const std::uint8_t replayCrowd = 4;
+
+class InputRecorder
+{
+	std::vector<InputRun> runs;
+
+	std::uint32_t tickCount;
+
+public:
+	InputRecorder() : tickCount(0) {}
+
+	void record(std::uint8_t input)
+	{
+		++tickCount;
+
+		if (!runs.empty() && runs.back().input == input)
+			++runs.back().length;
+		else
+			runs.push_back(InputRun{input, 1});
+	}
+
+	bool save(const std::string & path, std::uint32_t seed, sf::Vector2u windowSize, sf::Vector2i gridSize, bool destructible, bool patterns, bool crowd, SimulationDetail detail, Outcome outcome)
+	{
+		std::ofstream file(path, std::ios::binary);
+
+		if (!file)
+			return false;
+
+		file.write(replayMagic, sizeof(replayMagic));
+
+		writeValue(file, replayVersion);
+		writeValue(file, seed);
+		writeValue(file, windowSize.x);
+		writeValue(file, windowSize.y);
+		writeValue(file, gridSize.x);
+		writeValue(file, gridSize.y);
+		writeValue(file, tickCount);
+		writeValue(file, static_cast<std::uint8_t> (outcome));
+		writeValue(file, static_cast<std::uint8_t> ((destructible ? replayDestructible : 0) | (patterns ? replayPatterns : 0) | (crowd ? replayCrowd : 0)));
+		writeValue(file, detail.margin);
+		writeValue(file, detail.coarseInterval);
+		writeValue(file, detail.coarseBudget);
+		writeValue(file, static_cast<std::uint32_t> (runs.size()));
+
+		for (auto run : runs)
+		{
+			writeValue(file, run.input);
+			writeValue(file, run.length);
+		}
+
+		return static_cast<bool> (file);
+	}
+};
+
+class Replay
+{
+	std::uint32_t seed;
+
+	sf::Vector2u windowSize;
+	sf::Vector2i gridSize;
+
+	std::uint32_t tickCount;
+
+	Outcome outcome;
+
+	std::uint8_t flags;
+
+	SimulationDetail detail;
+
+	std::vector<InputRun> runs;
+
+	std::size_t currentRun;
+	std::uint32_t usedInRun;
+
+	std::uint32_t version;
+
+public:
+	Replay() : seed(0), tickCount(0), outcome(Outcome::Playing), flags(0), currentRun(0), usedInRun(0), version(0) {}
+
+	bool load(const std::string & path)
+	{
+		std::ifstream file(path, std::ios::binary);
+
+		char magic[4];
+		std::uint8_t outcomeValue;
+		std::uint32_t runCount;
+
+		if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, replayMagic, sizeof(magic)) != 0)
+			return false;
+
+		//version 3 is the same without the detail and version 2 without the flags
+		//as well. Neither moved anything off screen, so they play with no margin,
+		//but like every version before exactReplayVersion they are not exact
+		if (!readValue(file, version) || version < 2 || version > replayVersion)
+			return false;
+
+		if (!readValue(file, seed) || !readValue(file, windowSize.x) || !readValue(file, windowSize.y) || !readValue(file, gridSize.x) || !readValue(file, gridSize.y) || !readValue(file, tickCount) || !readValue(file, outcomeValue))
+			return false;
+
+		flags = 0;
+		detail = SimulationDetail();
+
+		if (version < 4)
+			detail.margin = 0;
+
+		if ((version >= 3 && !readValue(file, flags)) || (version >= 4 && !(readValue(file, detail.margin) && readValue(file, detail.coarseInterval) && readValue(file, detail.coarseBudget))) || !readValue(file, runCount))
+			return false;
+
+		if (gridSize.x <= 0 || gridSize.y <= 0)
+			return false;
+
+		outcome = static_cast<Outcome> (outcomeValue);
+
+		//a corrupt count must not allocate more runs than the file could hold
+		std::streampos start = file.tellg();
+
+		file.seekg(0, std::ios::end);
+
+		std::streamoff remaining = file.tellg() - start;
+
+		file.seekg(start);
+
+		if (remaining < 0 || runCount > static_cast<std::uint64_t> (remaining)/(sizeof(InputRun::input) + sizeof(InputRun::length)))
+			return false;
+
+		runs.resize(runCount);
+
+		for (auto & run : runs)
+			if (!readValue(file, run.input) || !readValue(file, run.length))
+				return false;
+
+		currentRun = 0;
+		usedInRun = 0;
+
+		return true;
+	}
+
+	bool finished() {return currentRun >= runs.size();}
+
+	std::uint8_t next()
+	{
+		assert(!finished());
+
+		std::uint8_t input = runs[currentRun].input;
+
+		if (++usedInRun >= runs[currentRun].length)
+		{
+			++currentRun;
+
+			usedInRun = 0;
+		}
+
+		return input;
+	}
+
+	std::uint32_t getSeed() {return seed;}
+
+	sf::Vector2u getWindowSize() {return windowSize;}
+
+	sf::Vector2i getGridSize() {return gridSize;}
+
+	std::uint32_t getTickCount() {return tickCount;}
+
+	Outcome getOutcome() {return outcome;}
+
+	bool isDestructible() {return flags & replayDestructible;}
+
+	bool hasPatterns() {return flags & replayPatterns;}
+
+	bool hasCrowd() {return flags & replayCrowd;}
+
+	SimulationDetail getDetail() {return detail;}
+
+	std::uint32_t getVersion() {return version;}
+
+	//whether the game still plays it the way it was recorded
+	bool isExact() {return version >= exactReplayVersion;}
+};
+
+class MainMenuScreen : public Screen
+{
+	sf::Text titleText;
+	sf::Text quitText;
+	sf::Text playText;
+	sf::Text instructionsText;
+
+	sf::Font * font;
+public:
+	MainMenuScreen(sf::Vector2i windowSize, sf::Font & font);
+
+	Screen * update(sf::RenderWindow & window);
+
+	void draw(sf::RenderTarget & target);
+};
+
+class InstructionsScreen : public Screen
+{
+	sf::Text titleText;
+	sf::Text backText;
+	sf::Text playerText;
+	sf::Text bulletText;
+	sf::Text turretText;
+	sf::Text movingTurretText;
+	sf::Text safeZoneText;
+	sf::Text finishZoneText;
+
+	sf::RectangleShape playerRectangle;
+	sf::RectangleShape bulletRectangle;
+	sf::RectangleShape turretRectangle;
+	sf::RectangleShape movingTurretRectangle;
+	sf::RectangleShape safeZoneRectangle;
+	sf::RectangleShape finishZoneRectangle;
+
+	sf::Font * font;
+
+	sf::Vector2f windowSize;
+public:
+	InstructionsScreen(sf::Vector2i windowSize, sf::Font & font);
+
+	Screen * update(sf::RenderWindow & window);
+	void draw(sf::RenderTarget & target);
+
+};
+
+class DeadScreen : public Screen
+{
+	sf::Text diedText;
+	sf::Text explanationText;
+	sf::Text backText;
+
+	sf::Font * font;
+
+	sf::Vector2i windowSize;
+
+public:
+	DeadScreen(sf::Vector2i windowSize, sf::Font & font);
+
+	Screen * update(sf::RenderWindow & window);
+
+	void draw(sf::RenderTarget & target);
+};
+
+class WinScreen : public Screen
+{
+	sf::Text winText;
+	sf::Text explanationText;
+	sf::Text backText;
+
+	sf::Font * font;
+
+	sf::Vector2i windowSize;
+
+public:
+	WinScreen(sf::Vector2i windowSize, sf::Font & font);
+
+	Screen * update(sf::RenderWindow & window);
+
+	void draw(sf::RenderTarget & target);
+};
+
+static_assert(std::is_trivially_copyable<Bullet>::value, "snapshots copy bullets with memcpy");
+static_assert(std::is_trivially_copyable<Turret>::value, "snapshots copy turrets with memcpy");
+static_assert(std::is_trivially_copyable<MovingTurret>::value, "snapshots copy moving turrets with memcpy");
+static_assert(std::is_trivially_copyable<Player>::value, "snapshots copy the player with memcpy");
+
+//everything a GameScreen changes while it runs. The level only changes in
+//destructible games, so only they copy it. Taking a snapshot into one that was
+//used before does not allocate
+class GameSnapshot
+{
+	friend class GameScreen;
+
+	struct State
+	{
+		std::uint32_t tickCount;
+
+		Player player;
+
+		sf::Vector2f viewCenter;
+
+		sf::FloatRect activeBounds;
+
+		std::size_t coarseCursor;
+	};
+
+	State state;
+
+	Random random;
+
+	std::vector<Bullet> bullets;
+	std::vector<Turret> turrets;
+	std::vector<MovingTurret> movingTurrets;
+
+	ScriptScheduler scripts;
+
+	//only kept for destructible games, where the level changes too
+	BlockGrid grid = BlockGrid(sf::Vector2i(0, 0));
+};
+
+class GameScreen : public Screen
+{
+	std::uint32_t seed;
+	std::uint32_t tickCount;
+
+	Random random;
+
+	InputRecorder recorder;
+
+	GameSnapshot levelStart;
+
+	//before the bullets, which keep a reference to it, so it is built first
+	BlockGrid blockGrid;
+
+	//for containers that only live for one tick, reset as each tick ends
+	FrameArena arena;
+
+	BulletStore bullets;
+	std::vector<Turret> turrets;
+	std::vector<MovingTurret> movingTurrets;
+	//std::vector<MovingSpawningTurret> movingSpawningTurrets;
+
+	ScriptScheduler scripts;
+
+	std::vector<Turret *> activeTurrets;
+	std::vector<MovingTurret *> activeMovingTurrets;
+
+	//moving turrets in the margin around the active area, moved coarsely a
+	//budget at a time starting from coarseCursor, round and round
+	std::vector<MovingTurret *> coarseMovingTurrets;
+	std::size_t coarseCursor;
+
+	SimulationDetail detail;
+	//std::vector<MovingSpawningTurret *> activeMovingSpawningTurrets;
+
+	//the level this tick was played at, and the governor picking the level
+	//for the next when the game is played live
+	int governorLevel;
+	FrameGovernor governor;
+	float tickMicroseconds;
+
+	Player player;
+
+	BlockGridChunks blockGridChunks;
+
+	bool destructible;
+	bool patterns;
+	bool crowd;
+
+	//where every moving turret is, kept up to date as they move, when they crowd
+	CrowdGrid crowdGrid;
+
+	sf::FloatRect activeBounds;
+
+	sf::View view;
+
+	std::vector<int> startRectanglePositions;
+	std::vector<sf::RectangleShape> rectangles;
+	sf::RectangleShape startRectangle;
+	sf::RectangleShape endRectangle;
+
+	//reshaped for each entity drawn, so drawing keeps nothing outside the game
+	sf::RectangleShape entityRectangle;
+
+	sf::Font * font;
+
+	sf::Vector2u windowSize;
+
+	void centerView()
+	{
+		view.setCenter(player.getPosition());
+
+		if (view.getCenter().x - view.getSize().x/2 < 0)
+			view.setCenter(view.getSize().x/2, view.getCenter().y);
+
+		if (view.getCenter().y - view.getSize().y/2 < 0)
+			view.setCenter(view.getCenter().x, view.getSize().y/2);
+
+		if (view.getCenter().x >= blockGrid.getBlockSize()*blockGrid.getSize().x - view.getSize().x/2)
+			view.setCenter(blockGrid.getBlockSize()*blockGrid.getSize().x - view.getSize().x/2, view.getCenter().y);
+
+		if (view.getCenter().y >= blockGrid.getBlockSize()*blockGrid.getSize().y - view.getSize().y/2)
+			view.setCenter(view.getCenter().x, blockGrid.getBlockSize()*blockGrid.getSize().y - view.getSize().y/2);
+	}
+
+	void activate()
+	{
+		activeTurrets.clear();
+		activeMovingTurrets.clear();
+		coarseMovingTurrets.clear();
+//		activeMovingSpawningTurrets.clear();
+
+		for (Turret & turret : turrets)
+			if (turret.getPosition().x > activeBounds.left - 10 && turret.getPosition().x < activeBounds.left + activeBounds.width + 10 && turret.getPosition().y > activeBounds.top - 10 && turret.getPosition().y < activeBounds.top + activeBounds.height + 10)
+				activeTurrets.push_back(&turret);
+
+		auto within = [&](sf::Vector2f position, float margin) {return position.x > activeBounds.left - margin && position.x < activeBounds.left + activeBounds.width + margin && position.y > activeBounds.top - margin && position.y < activeBounds.top + activeBounds.height + margin;};
+
+		const float margin = 10 + detail.margin;
+		const float governedMargin = 10 + (governorLevel >= GovernorShrinkMargin ? detail.margin/4 : detail.margin);
+
+		for (MovingTurret & turret : movingTurrets)
+			if (within(turret.getPosition(), 10))
+				activeMovingTurrets.push_back(&turret);
+			else if (within(turret.getPosition(), governedMargin))
+				coarseMovingTurrets.push_back(&turret);
+			else if (governedMargin < margin && within(turret.getPosition(), margin))
+				PROFILE_COUNT(CounterShedTurrets, 1);
+
+		/*for (MovingSpawningTurret & turret : movingSpawningTurrets)
+			if (turret.getPosition().x > activeBounds.left - 10 && turret.getPosition().x < activeBounds.left + activeBounds.width + 10 && turret.getPosition().y > activeBounds.top - 10 && turret.getPosition().y < activeBounds.top + activeBounds.height + 10)
+				activeMovingSpawningTurrets.push_back(&turret);*/
+	}
+
+	void placeCrowd()
+	{
+		if (!crowd)
+			return;
+
+		crowdGrid.reset(sf::Vector2i(blockGrid.getBlockSize()*blockGrid.getSize().x, blockGrid.getBlockSize()*blockGrid.getSize().y), movingTurrets.size());
+
+		for (std::size_t i = 0; i < movingTurrets.size(); ++i)
+			crowdGrid.place(i, movingTurrets[i].getPosition());
+	}
+
+	void saveReplay(Outcome outcome)
+	{
+		if (!settings.recordPath.empty() && !recorder.save(settings.recordPath, seed, windowSize, blockGrid.getSize(), destructible, patterns, crowd, detail, outcome))
+			std::cerr << "Could not write replay to " << settings.recordPath << std::endl;
+	}
+
+	void setup()
+	{
+		//the active lists never need more room than this, and bullets
+		//only grow past it on the busiest levels
+		activeTurrets.reserve(turrets.size());
+		activeMovingTurrets.reserve(movingTurrets.size());
+		coarseMovingTurrets.reserve(movingTurrets.size());
+
+		bullets.reserve(256);
+
+		scripts.reserve(turrets.size());
+
+		for (Turret & turret : turrets)
+			turret.setScript(scripts.start());
+
+		//each turret gets one of the patterns other than the single shot
+		if (patterns)
+		{
+			for (std::size_t i = 0; i < turrets.size(); ++i)
+				turrets[i].setPattern(1 + i % (emitterPatternCount - 1));
+
+			for (std::size_t i = 0; i < movingTurrets.size(); ++i)
+				movingTurrets[i].setPattern(1 + (i + 2) % (emitterPatternCount - 1));
+		}
+
+		for (std::size_t i = 0; i < movingTurrets.size(); ++i)
+			movingTurrets[i].setCrowdIndex(i);
+
+		placeCrowd();
+
+		activeBounds.left = 0;
+		activeBounds.top = 0;
+		activeBounds.width = windowSize.x*1.1;
+		activeBounds.height = windowSize.y*1.1;
+
+		for (int i = 0; i < 1; ++i)
+			startRectanglePositions.push_back(i*600);
+
+		startRectangle.setPosition(0, 0);
+
+		startRectangle.setFillColor(sf::Color(0, 0, 255, 50));
+
+		for (int i = 0; i < startRectanglePositions.size(); ++i)
+		{
+			sf::RectangleShape rectangle(startRectangle);
+
+			rectangle.setPosition(startRectanglePositions[i], 0);
+
+			rectangles.push_back(rectangle);
+		}
+
+		endRectangle.setPosition(blockGrid.getBlockSize()*(blockGrid.getSize().x - 3), 0);
+
+		endRectangle.setFillColor(sf::Color(255, 0, 0, 50));
+	}
+
+public:
+	//font may be null when the game is only simulated, never drawn
+	GameScreen(sf::Vector2u windowSize, sf::Font * font, std::uint32_t seed, sf::Vector2i gridSize, float turretDensity = 1, bool destructible = false, BlockStorage blockStorage = BlockStorage::Bits, SimulationDetail detail = SimulationDetail(), bool patterns = false, bool crowd = false) : seed(seed), tickCount(0), random(seed), blockGrid(gridSize, blockStorage), bullets(blockGrid), coarseCursor(0), detail(detail), governorLevel(GovernorFull), governor(settings.frameBudget), tickMicroseconds(0), blockGridChunks(gridSize), destructible(destructible), patterns(patterns), crowd(crowd), view(sf::FloatRect(0, 0, windowSize.x, windowSize.y)), startRectangle(sf::Vector2f(blockGrid.getBlockSize()*3, blockGrid.getSize().y*blockGrid.getBlockSize())), endRectangle(sf::Vector2f(blockGrid.getBlockSize()*3, blockGrid.getSize().y*blockGrid.getBlockSize())), font(font), windowSize(windowSize)
+	{
+		createLevel(seed, blockGrid, turrets, movingTurrets, turretDensity);
+		//populateMovingSpawningTurrets(movingSpawningTurrets, blockGrid, random);
+
+		setup();
+
+		snapshot(levelStart);
+	}
+
+	GameScreen(sf::Vector2u windowSize, sf::Font * font, Level & level) : seed(level.getSeed()), tickCount(0), random(seed), blockGrid(level.getGrid(settings.blockStorage)), bullets(blockGrid), coarseCursor(0), detail(settings.detail), governorLevel(GovernorFull), governor(settings.frameBudget), tickMicroseconds(0), blockGridChunks(blockGrid.getSize()), destructible(settings.destructible), patterns(settings.patterns), crowd(settings.crowd), view(sf::FloatRect(0, 0, windowSize.x, windowSize.y)), startRectangle(sf::Vector2f(blockGrid.getBlockSize()*3, blockGrid.getSize().y*blockGrid.getBlockSize())), endRectangle(sf::Vector2f(blockGrid.getBlockSize()*3, blockGrid.getSize().y*blockGrid.getBlockSize())), font(font), windowSize(windowSize)
+	{
+		turrets.reserve(level.getTurretCount());
+		movingTurrets.reserve(level.getMovingTurretCount());
+
+		for (std::uint32_t i = 0; i < level.getTurretCount(); ++i)
+			turrets.push_back(Turret(sf::Vector2f(level.getTurrets()[i].x, level.getTurrets()[i].y), level.getTurrets()[i].shotsPerSecond));
+
+		for (std::uint32_t i = 0; i < level.getMovingTurretCount(); ++i)
+			movingTurrets.push_back(MovingTurret(sf::Vector2f(level.getMovingTurrets()[i].x, level.getMovingTurrets()[i].y), level.getMovingTurrets()[i].speed, level.getMovingTurrets()[i].shotsPerSecond));
+
+		setup();
+
+		snapshot(levelStart);
+	}
+
+	Screen * update(sf::RenderWindow & window)
+	{
+		sf::Event evt;
+
+		while (window.pollEvent(evt))
+		{
+			if (evt.type == sf::Event::Closed)
+			{
+				saveReplay(Outcome::Playing);
+
+				std::exit(0);
+			}
+
+#ifdef ENABLE_PROFILER
+			if (evt.type == sf::Event::KeyPressed && evt.key.code == sf::Keyboard::F3)
+				profiler.visible = !profiler.visible;
+#endif
+		}
+
+		std::uint8_t input = readInput() | governor.getLevel() << inputGovernorShift;
+
+		recorder.record(input);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		Outcome outcome = tick(input);
+
+		tickMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		if (outcome != Outcome::Playing)
+		{
+			saveReplay(outcome);
+
+			window.setView(window.getDefaultView());
+
+			if (outcome == Outcome::Won)
+				return new WinScreen(sf::Vector2i(window.getSize().x, window.getSize().y), *font);
+			else
+				return new DeadScreen(sf::Vector2i(window.getSize().x, window.getSize().y), *font);
+		}
+
+		return this;
+	}
+
+	void snapshot(GameSnapshot & snapshot)
+	{
+		snapshot.state.tickCount = tickCount;
+		snapshot.state.player = player;
+		snapshot.state.viewCenter = view.getCenter();
+		snapshot.state.activeBounds = activeBounds;
+		snapshot.state.coarseCursor = coarseCursor;
+
+		snapshot.random = random;
+
+		snapshot.bullets.assign(bullets.begin(), bullets.end());
+		snapshot.turrets.assign(turrets.begin(), turrets.end());
+		snapshot.movingTurrets.assign(movingTurrets.begin(), movingTurrets.end());
+		snapshot.scripts = scripts;
+
+		if (destructible)
+			snapshot.grid = blockGrid;
+	}
+
+	sf::Vector2f getPlayerPosition() {return player.getPosition();}
+
+	std::size_t getBulletCount() {return bullets.size();}
+
+	std::uint64_t getSpawnedBulletCount() {return bullets.getSpawnedCount();}
+
+	BlockGridMemory getGridMemory() {return blockGrid.getMemory();}
+
+	FrameArena & getArena() {return arena;}
+
+	void restore(const GameSnapshot & snapshot)
+	{
+		tickCount = snapshot.state.tickCount;
+		player = snapshot.state.player;
+		activeBounds = snapshot.state.activeBounds;
+		coarseCursor = snapshot.state.coarseCursor;
+
+		view.setCenter(snapshot.state.viewCenter);
+
+		random = snapshot.random;
+
+		if (destructible)
+		{
+			blockGrid = snapshot.grid;
+
+			blockGridChunks.invalidate(blockGrid);
+		}
+
+		bullets.assign(snapshot.bullets, tickCount);
+		turrets.assign(snapshot.turrets.begin(), snapshot.turrets.end());
+		movingTurrets.assign(snapshot.movingTurrets.begin(), snapshot.movingTurrets.end());
+		scripts = snapshot.scripts;
+
+		placeCrowd();
+
+		activate();
+	}
+
+	//advances the simulation by one tick, touching neither the window nor the keyboard.
+	//InputRestart puts the level back the way it started
+	Outcome tick(std::uint8_t input)
+	{
+		PROFILE_BEGIN_TICK();
+		PROFILE_SCOPE(PhaseTick);
+
+		FrameArena::Frame frame(arena);
+
+		++tickCount;
+
+		governorLevel = (input & InputGovernor) >> inputGovernorShift;
+
+		PROFILE_COUNT(CounterGovernorLevel, governorLevel);
+
+		if (input & InputRestart)
+		{
+			restore(levelStart);
+
+			return Outcome::Playing;
+		}
+
+		bullets.setTick(tickCount);
+		bullets.setSpawnLimit(governorLevel >= GovernorCapSpawns ? governedSpawnsPerTick : std::numeric_limits<std::uint32_t>::max());
+
+		{
+			PROFILE_SCOPE(PhaseBullets);
+
+			for (Bullet & bullet : bullets)
+				bullet.update();
+		}
+
+		{
+			PROFILE_SCOPE(PhaseActivation);
+
+			activate();
+
+			PROFILE_COUNT(CounterActiveTurrets, activeTurrets.size() + activeMovingTurrets.size());
+		}
+
+		if (sf::FloatRect(player.getPosition().x, player.getPosition().y, player.getSize(), player.getSize()).intersects(endRectangle.getGlobalBounds()))
+			return Outcome::Won;
+
+		bool playerSafe = false;
+
+		for (const auto & rect : rectangles)
+			if (sf::FloatRect(player.getPosition().x, player.getPosition().y, player.getSize(), player.getSize()).intersects(rect.getGlobalBounds()))
+				playerSafe = true;
+
+		sf::Vector2f target = player.getPosition();
+
+		if (playerSafe)
+			target = sf::Vector2f(0, 0);
+
+		{
+			PROFILE_SCOPE(PhaseTurrets);
+
+			//every turret looks at the same target, so their rays are marched together
+			ArenaVector<sf::Vector2f> eyes(arena);
+			ArenaVector<std::uint8_t> seen(arena);
+			ArenaVector<std::uint8_t> sight(arena);
+
+			sight.resize(activeTurrets.size() + activeMovingTurrets.size(), false);
+
+			eyes.reserve(sight.size());
+
+			//turrets only look while their script waits to see the player, moving
+			//turrets every tick, and the governor can have them all look only every other tick
+			auto looks = [&](std::size_t i) {return (governorLevel < GovernorStaleSight || (i + tickCount) % 2 == 0) && (i >= activeTurrets.size() || scripts.isWaitingForSight(activeTurrets[i]->getScript()));};
+
+			for (std::size_t i = 0; i < activeTurrets.size(); ++i)
+				if (looks(i))
+					eyes.push_back(activeTurrets[i]->getPosition());
+
+			for (std::size_t i = 0; i < activeMovingTurrets.size(); ++i)
+				if (looks(activeTurrets.size() + i))
+					eyes.push_back(activeMovingTurrets[i]->getPosition());
+				else
+				{
+					sight[activeTurrets.size() + i] = activeMovingTurrets[i]->getSawTarget();
+
+					PROFILE_COUNT(CounterStaleSights, 1);
+				}
+
+			seen.resize(eyes.size(), false);
+
+			if (target != sf::Vector2f(0, 0))
+				lineOfSightBatch(eyes.data(), eyes.size(), target, blockGrid, seen.data());
+
+			for (std::size_t i = 0, j = 0; i < sight.size(); ++i)
+				if (looks(i))
+					sight[i] = seen[j++];
+
+			if (target != sf::Vector2f(0, 0))
+				for (std::size_t i = 0; i < activeTurrets.size(); ++i)
+					if (scripts.isReady(activeTurrets[i]->getScript(), tickCount, sight[i]))
+					{
+						activeTurrets[i]->run(scripts[activeTurrets[i]->getScript()], target, bullets, tickCount);
+
+						PROFILE_COUNT(CounterScripts, 1);
+					}
+
+			for (std::size_t i = 0; i < activeMovingTurrets.size(); ++i)
+				activeMovingTurrets[i]->update(target, sight[activeTurrets.size() + i], bullets, blockGrid, tickCount, crowd ? &crowdGrid : nullptr);
+
+			//off screen turrets due a coarse move, no more than the budget of them
+			std::size_t coarseUpdates = 0;
+
+			if (target != sf::Vector2f(0, 0))
+				for (std::size_t i = 0; i < coarseMovingTurrets.size() && coarseUpdates < detail.coarseBudget; ++i)
+				{
+					std::size_t index = (coarseCursor + i) % coarseMovingTurrets.size();
+
+					if (tickCount - coarseMovingTurrets[index]->getLastUpdateTick() >= detail.coarseInterval)
+					{
+						coarseMovingTurrets[index]->coarseUpdate(target, blockGrid, tickCount, 4*detail.coarseInterval, crowd ? &crowdGrid : nullptr);
+
+						coarseCursor = index + 1;
+
+						++coarseUpdates;
+					}
+				}
+
+			PROFILE_COUNT(CounterCoarseTurrets, coarseUpdates);
+
+			/*for (MovingSpawningTurret * turret : activeMovingSpawningTurrets)
+				turret->update(target, movingSpawningTurrets, bullets, blockGrid, random, tickCount);*/
+		}
+
+		sf::Vector2f playerStart = player.getPosition();
+
+		{
+			PROFILE_SCOPE(PhasePlayer);
+
+			player.update(blockGrid, input);
+		}
+
+		centerView();
+
+		activeBounds.left = view.getCenter().x - view.getSize().x/2;
+		activeBounds.top = view.getCenter().y - view.getSize().y/2;
+
+		bool playerHit = false;
+
+		{
+			PROFILE_SCOPE(PhaseKillCheck);
+
+			//bullets hitting a wall this tick only count up to the wall
+			if (!playerSafe)
+				for (Bullet & bullet : bullets)
+					if (playerBulletCollision(playerStart, player, bullet, bullet.getExpiryTick() == tickCount ? bullet.getImpact() : 1))
+					{
+						playerHit = true;
+
+						break;
+					}
+		}
+
+		{
+			PROFILE_SCOPE(PhaseBulletRemoval);
+
+			ArenaVector<sf::Vector2i> impacts(arena);
+
+			//the tick each bullet hits a wall or leaves the level was worked out when it was fired
+			bullets.retire(impacts);
+
+			if (destructible && !impacts.empty())
+			{
+				for (sf::Vector2i block : impacts)
+					blockGrid.setSolid(block.x, block.y, false);
+
+				bullets.repredict(impacts);
+			}
+
+			PROFILE_COUNT(CounterBullets, bullets.size());
+		}
+
+		return (playerHit ? Outcome::Died : Outcome::Playing);
+	}
+
+	void draw(sf::RenderTarget & target)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		{
+			PROFILE_SCOPE(PhaseDraw);
+
+			target.clear(sf::Color::White);
+
+			target.setView(view);
+
+			{
+				PROFILE_SCOPE(PhaseDrawGrid);
+
+				blockGridChunks.draw(target, blockGrid, activeBounds);
+			}
+
+			{
+				PROFILE_SCOPE(PhaseDrawZones);
+
+				for (const auto & rect : rectangles)
+					target.draw(rect);//target.draw(startRectangle);
+				target.draw(endRectangle);
+			}
+
+			{
+				PROFILE_SCOPE(PhaseDrawEntities);
+
+				player.draw(target, entityRectangle);
+
+				if (governorLevel >= GovernorCullBullets)
+				{
+					sf::FloatRect visible(view.getCenter() - view.getSize()/2.f - sf::Vector2f(10, 10), view.getSize() + sf::Vector2f(20, 20));
+
+					for (Bullet & bullet : bullets)
+						if (visible.contains(bullet.getPosition()))
+							bullet.draw(target, entityRectangle);
+						else
+							PROFILE_COUNT(CounterCulledBullets, 1);
+				}
+				else
+					for (Bullet & bullet : bullets)
+						bullet.draw(target, entityRectangle);
+
+				for (Turret * turret : activeTurrets)
+					turret->draw(target, entityRectangle);
+
+				for (MovingTurret * turret : activeMovingTurrets)
+					turret->draw(target, entityRectangle);
+
+/*				for (MovingSpawningTurret * turret : activeMovingSpawningTurrets)
+					turret->draw(target, entityRectangle);*/
+			}
+		}
+
+#ifdef ENABLE_PROFILER
+		if (profiler.visible && font != nullptr)
+		{
+			target.setView(target.getDefaultView());
+
+			profiler.draw(target, *font);
+
+			target.setView(view);
+		}
+#endif
+
+		governor.record(tickMicroseconds + std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count());
+	}
+};
+
+MainMenuScreen::MainMenuScreen(sf::Vector2i windowSize, sf::Font & font) : font(&font)
+{
+	titleText.setFont(font);
+	quitText.setFont(font);
+	playText.setFont(font);
+	instructionsText.setFont(font);
+
+	titleText.setFillColor(sf::Color::Black);
+	titleText.setCharacterSize(30);
+	titleText.setString("Death By Dots");
+	titleText.setOrigin(titleText.getLocalBounds().width/2, titleText.getLocalBounds().height/2);
+	titleText.setPosition(windowSize.x/2, windowSize.y/7);
+
+	playText.setFillColor(sf::Color::Black);
+	playText.setCharacterSize(20);
+	playText.setString("Play");
+	playText.setOrigin(playText.getLocalBounds().width/2, playText.getLocalBounds().height/2);
+	playText.setPosition(windowSize.x/2, windowSize.y/4);
+
+	instructionsText.setFillColor(sf::Color::Black);
+	instructionsText.setCharacterSize(20);
+	instructionsText.setString("Instructions");
+	instructionsText.setOrigin(instructionsText.getLocalBounds().width/2, instructionsText.getLocalBounds().height/2);
+	instructionsText.setPosition(windowSize.x/2, windowSize.y/3);
+
+	quitText.setFillColor(sf::Color::Black);
+	quitText.setCharacterSize(20);
+	quitText.setString("Quit");
+	quitText.setOrigin(quitText.getLocalBounds().width/2, quitText.getLocalBounds().height/2);
+	quitText.setPosition(windowSize.x/2, windowSize.y/2);
+}
+
+Screen * MainMenuScreen::update(sf::RenderWindow & window)
+{
+	sf::Event evt;
+
+	while (window.pollEvent(evt))
+	{
+		if (evt.type == sf::Event::Closed)
+			return nullptr;
+
+		if (evt.type == sf::Event::MouseButtonPressed)
+		{
+			if (evt.mouseButton.x >= playText.getGlobalBounds().left && evt.mouseButton.y >= playText.getGlobalBounds().top &&
+				evt.mouseButton.x < playText.getGlobalBounds().left + playText.getGlobalBounds().width &&
+				evt.mouseButton.y < playText.getGlobalBounds().top + playText.getGlobalBounds().height)
+			{
+					if (!settings.levelPath.empty())
+					{
+						Level level;
+
+						if (level.load(settings.levelPath))
+							return new GameScreen(window.getSize(), font, level);
+
+						std::cerr << "Could not load level " << settings.levelPath << std::endl;
+					}
+
+					return new GameScreen(window.getSize(), font, std::random_device()(), defaultGridSize(window.getSize()), 1, settings.destructible, settings.blockStorage, settings.detail, settings.patterns, settings.crowd);
+			}
+
+			if (evt.mouseButton.x >= instructionsText.getGlobalBounds().left && evt.mouseButton.y >= instructionsText.getGlobalBounds().top &&
+				evt.mouseButton.x < instructionsText.getGlobalBounds().left + instructionsText.getGlobalBounds().width &&
+				evt.mouseButton.y < instructionsText.getGlobalBounds().top + instructionsText.getGlobalBounds().height)
+			{
+				return new InstructionsScreen(sf::Vector2i(window.getSize().x, window.getSize().y), *font);
+			}
+
+			if (evt.mouseButton.x >= quitText.getGlobalBounds().left && evt.mouseButton.y >= quitText.getGlobalBounds().top &&
+				evt.mouseButton.x < quitText.getGlobalBounds().left + quitText.getGlobalBounds().width &&
+				evt.mouseButton.y < quitText.getGlobalBounds().top + quitText.getGlobalBounds().height)
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	return this;
+}
+
+void MainMenuScreen::draw(sf::RenderTarget & target)
+{
+	target.clear(sf::Color::White);
+
+	target.draw(titleText);
+	target.draw(playText);
+	target.draw(instructionsText);
+	target.draw(quitText);
+}
+
+InstructionsScreen::InstructionsScreen(sf::Vector2i windowSize, sf::Font & font)
+{
+	windowSize = windowSize;
+
+	this->font = &font;
+
+	titleText.setFont(font);
+	backText.setFont(font);
+	playerText.setFont(font);
+	bulletText.setFont(font);
+	turretText.setFont(font);
+	movingTurretText.setFont(font);
+	safeZoneText.setFont(font);
+	finishZoneText.setFont(font);
+
+
+	titleText.setString("Instructions");
+	titleText.setCharacterSize(30);
+	titleText.setOrigin(titleText.getLocalBounds().width/2, titleText.getLocalBounds().height/5);
+	titleText.setPosition(windowSize.x/2, windowSize.y/7);
+	titleText.setFillColor(sf::Color::Black);
+
+	backText.setString("Main Menu");
+	backText.setCharacterSize(20);
+	backText.setOrigin(backText.getLocalBounds().width/2, backText.getLocalBounds().height/2);
+	backText.setPosition(windowSize.x/2, windowSize.y/1.2);
+	backText.setFillColor(sf::Color::Black);
+
+
+	Player player;
+
+	playerRectangle.setSize(sf::Vector2f(player.getSize(), player.getSize()));
+	playerRectangle.setFillColor(sf::Color::Red);
+
+	playerRectangle.setPosition(windowSize.x/8, windowSize.y/5);
+
+	playerText.setString("This is you. Move with the arrow keys or A,W,S,D.");
+	playerText.setCharacterSize(20);
+	playerText.setPosition(playerRectangle.getPosition().x + playerRectangle.getGlobalBounds().width + 10, playerRectangle.getPosition().y);
+	playerText.setFillColor(sf::Color::Black);
+
+	Bullet bullet(sf::Vector2f(), 10, 10, 0);
+
+	bulletRectangle.setSize(sf::Vector2f(bullet.getSize(), bullet.getSize()));
+	bulletRectangle.setFillColor(sf::Color::Black);
+
+	bulletRectangle.setPosition(windowSize.x/8, windowSize.y/4);
+
+	bulletText.setString("This is a bullet. Don't get hit by them.");
+	bulletText.setCharacterSize(20);
+	bulletText.setPosition(bulletRectangle.getPosition().x + bulletRectangle.getGlobalBounds().width + 10, bulletRectangle.getPosition().y);
+	bulletText.setFillColor(sf::Color::Black);
+
+	Turret turret(sf::Vector2f(), 0);
+
+	turretRectangle.setSize(sf::Vector2f(turret.getSize(), turret.getSize()));
+	turretRectangle.setFillColor(sf::Color::Yellow);
+
+	turretRectangle.setPosition(windowSize.x/8, windowSize.y/3.5);
+
+	turretText.setString("This is a turret. It shoots bullets");
+	turretText.setCharacterSize(20);
+	turretText.setPosition(turretRectangle.getPosition().x + turretRectangle.getGlobalBounds().width + 10, turretRectangle.getPosition().y);
+	turretText.setFillColor(sf::Color::Black);
+
+	MovingTurret movingTurret(sf::Vector2f(), 0, 0);
+
+	movingTurretRectangle.setSize(sf::Vector2f(movingTurret.getSize(), movingTurret.getSize()));
+	movingTurretRectangle.setFillColor(sf::Color::Green);
+
+	movingTurretRectangle.setPosition(windowSize.x/8, windowSize.y/3.f);
+
+	movingTurretText.setString("Like a turret, but it moves.");
+	movingTurretText.setCharacterSize(20);
+	movingTurretText.setPosition(movingTurretRectangle.getPosition().x + movingTurretRectangle.getGlobalBounds().width + 10, movingTurretRectangle.getPosition().y);
+	movingTurretText.setFillColor(sf::Color::Black);
+
+	BlockGrid blockGrid(sf::Vector2i(0, 0));
+
+	safeZoneRectangle.setSize(sf::Vector2f(blockGrid.getBlockSize(), blockGrid.getBlockSize()));
+	safeZoneRectangle.setFillColor(sf::Color(0, 0, 255, 50));
+
+	safeZoneRectangle.setPosition(windowSize.x/8, windowSize.y/2.5);
+
+	safeZoneText.setString("You are safe when touching this.");
+	safeZoneText.setCharacterSize(20);
+	safeZoneText.setPosition(safeZoneRectangle.getPosition().x + safeZoneRectangle.getGlobalBounds().width + 10, safeZoneRectangle.getPosition().y);
+	safeZoneText.setFillColor(sf::Color::Black);
+
+	finishZoneRectangle.setSize(sf::Vector2f(blockGrid.getBlockSize(), blockGrid.getBlockSize()));
+	finishZoneRectangle.setFillColor(sf::Color(255, 0, 0, 50));
+
+	finishZoneRectangle.setPosition(windowSize.x/8, windowSize.y/2);
+
+	finishZoneText.setString("Touch this to win");
+	finishZoneText.setCharacterSize(20);
+	finishZoneText.setPosition(finishZoneRectangle.getPosition().x + finishZoneRectangle.getGlobalBounds().width + 10, finishZoneRectangle.getPosition().y);
+	finishZoneText.setFillColor(sf::Color::Black);
+}
+
+Screen * InstructionsScreen::update(sf::RenderWindow & window)
+{
+	sf::Event evt;
+
+	while (window.pollEvent(evt))
+	{
+		if (evt.type == sf::Event::Closed)
+			return nullptr;
+
+		if (evt.type == sf::Event::MouseButtonPressed)
+		{
+			if (evt.mouseButton.x >= backText.getGlobalBounds().left && evt.mouseButton.y >= backText.getGlobalBounds().top &&
+				evt.mouseButton.x < backText.getGlobalBounds().left + backText.getGlobalBounds().width &&
+				evt.mouseButton.y < backText.getGlobalBounds().top + backText.getGlobalBounds().height)
+			{
+				return new MainMenuScreen(sf::Vector2i(window.getSize().x, window.getSize().y), *font);
+			}
+		}
+	}
+
+	return this;
+}
+
+void InstructionsScreen::draw(sf::RenderTarget & target)
+{
+	target.clear(sf::Color::White);
+
+	target.draw(titleText);
+	target.draw(backText);
+	target.draw(playerText);
+	target.draw(bulletText);
+	target.draw(turretText);
+	target.draw(movingTurretText);
+	target.draw(safeZoneText);
+	target.draw(finishZoneText);
+
+	target.draw(playerRectangle);
+	target.draw(bulletRectangle);
+	target.draw(turretRectangle);
+	target.draw(movingTurretRectangle);
+	target.draw(safeZoneRectangle);
+	target.draw(finishZoneRectangle);
+}
+
+DeadScreen::DeadScreen(sf::Vector2i windowSize, sf::Font & font)
+{
+	this->font = &font;
+	this->windowSize = windowSize;
 
-						break;
-					}
+	diedText.setFont(font);
+	explanationText.setFont(font);
+	backText.setFont(font);
 
-				prevX = position.x;
-			}
+	diedText.setFillColor(sf::Color::Black);
+	diedText.setCharacterSize(30);
+	diedText.setString("You died!");
+	diedText.setOrigin(diedText.getLocalBounds().width/2, diedText.getLocalBounds().height/2);
+	diedText.setPosition(windowSize.x/2, windowSize.y/5);
 
-			for (int i = 0; i < std::abs(yMove); ++i)
+	explanationText.setFillColor(sf::Color::Black);
+	explanationText.setCharacterSize(20);
+	explanationText.setString("Looks like you just aren't good enough.");
+	explanationText.setOrigin(explanationText.getLocalBounds().width/2, explanationText.getLocalBounds().height/2);
+	explanationText.setPosition(windowSize.x/2, windowSize.y/3);
+
+	backText.setFillColor(sf::Color::Black);
+	backText.setCharacterSize(20);
+	backText.setString("Main Menu");
+	backText.setOrigin(backText.getLocalBounds().width/2, backText.getLocalBounds().height/2);
+	backText.setPosition(windowSize.x/2, windowSize.y/2);
+		
+}
+
+Screen * DeadScreen::update(sf::RenderWindow & window)
+{
+	sf::Event evt;
+
+	while (window.pollEvent(evt))
+	{
+		if (evt.type == sf::Event::Closed)
+			return nullptr;
+
+		if (evt.type == sf::Event::MouseButtonPressed)
+		{
+			if (evt.mouseButton.x >= backText.getGlobalBounds().left && evt.mouseButton.y >= backText.getGlobalBounds().top &&
+				evt.mouseButton.x < backText.getGlobalBounds().left + backText.getGlobalBounds().width &&
+				evt.mouseButton.y < backText.getGlobalBounds().top + backText.getGlobalBounds().height)
 			{
-				int increment = sign(yMove);
+				return new MainMenuScreen(windowSize, *font);
+			}
+		}
+	}
 
-				position.y += increment;
+	return this;
+}
 
-				std::vector<sf::Vector2i> blocks;
+void DeadScreen::draw(sf::RenderTarget & target)
+{
+	target.clear(sf::Color::White);
+	target.draw(diedText);
+	target.draw(explanationText);
+	target.draw(backText);
+}
 
-				blocks.push_back(sf::Vector2i((position.x - size/2)/grid.getBlockSize(), (position.y - size/2)/grid.getBlockSize()));
-				blocks.push_back(sf::Vector2i(std::ceil((position.x + size/2) /grid.getBlockSize()), std::ceil((position.y + size/2)/grid.getBlockSize())));
-				blocks.push_back(sf::Vector2i(std::ceil((position.x + size/2)/grid.getBlockSize()), (position.y - size/2)/grid.getBlockSize()));
-				blocks.push_back(sf::Vector2i((position.x - size/2)/grid.getBlockSize(), std::ceil((position.y + size/2)/grid.getBlockSize())));
 
-				if (position.y < 0 || position.y > grid.getBlockSize()*grid.getSize().y - size)
-				{
-					position.y = prevY;
+WinScreen::WinScreen(sf::Vector2i windowSize, sf::Font & font)
+{
+	this->font = &font;
+	this->windowSize = windowSize;
 
-					break;
-				}
+	winText.setFont(font);
+	explanationText.setFont(font);
+	backText.setFont(font);
 
-				for (auto block : blocks)
-					if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
-					{
-						position.y = prevY;
+	winText.setFillColor(sf::Color::Black);
+	winText.setCharacterSize(30);
+	winText.setString("You win!");
+	winText.setOrigin(winText.getLocalBounds().width/2, winText.getLocalBounds().height/2);
+	winText.setPosition(windowSize.x/2, windowSize.y/5);
 
-						break;
-					}
+	explanationText.setFillColor(sf::Color::Black);
+	explanationText.setCharacterSize(20);
+	explanationText.setString("Get over it.");
+	explanationText.setOrigin(explanationText.getLocalBounds().width/2, explanationText.getLocalBounds().height/2);
+	explanationText.setPosition(windowSize.x/2, windowSize.y/3);
 
-				prevY = position.y;
+	backText.setFillColor(sf::Color::Black);
+	backText.setCharacterSize(20);
+	backText.setString("Main Menu");
+	backText.setOrigin(backText.getLocalBounds().width/2, backText.getLocalBounds().height/2);
+	backText.setPosition(windowSize.x/2, windowSize.y/2);
+}
+
+Screen * WinScreen::update(sf::RenderWindow & window)
+{
+	sf::Event evt;
+
+	while (window.pollEvent(evt))
+	{
+		if (evt.type == sf::Event::Closed)
+			return nullptr;
+
+		if (evt.type == sf::Event::MouseButtonPressed)
+		{
+			if (evt.mouseButton.x >= backText.getGlobalBounds().left && evt.mouseButton.y >= backText.getGlobalBounds().top &&
+				evt.mouseButton.x < backText.getGlobalBounds().left + backText.getGlobalBounds().width &&
+				evt.mouseButton.y < backText.getGlobalBounds().top + backText.getGlobalBounds().height)
+			{
+				return new MainMenuScreen(windowSize, *font);
 			}
+		}
+	}
 
-			/*position = cornerPosition;
+	return this;
+}
 
-			int extra = (size/2) % 2 == 0 ? 0 : 1;
+void WinScreen::draw(sf::RenderTarget & target)
+{
+	target.clear(sf::Color::White);
+	target.draw(winText);
+	target.draw(explanationText);
+	target.draw(backText);
+}
 
-			position.x += size/2 + extra;
-			position.y += size/2 + extra;*/
+
+
+
+int runReplay(const std::string & path)
+{
+	Replay replay;
+
+	if (!replay.load(path))
+	{
+		std::cerr << "Could not load replay " << path << std::endl;
+
+		return 1;
+	}
+
+	GameScreen game(replay.getWindowSize(), nullptr, replay.getSeed(), replay.getGridSize(), 1, replay.isDestructible(), settings.blockStorage, replay.getDetail(), replay.hasPatterns(), replay.hasCrowd());
+
+	Outcome outcome = Outcome::Playing;
+
+	std::uint32_t ticks = 0;
+
+	sf::Clock clock;
+
+	while (outcome == Outcome::Playing && !replay.finished())
+	{
+		outcome = game.tick(replay.next());
+
+		++ticks;
+	}
+
+	float seconds = clock.getElapsedTime().asSeconds();
+
+	std::cout << "version: " << replay.getVersion() << (replay.isExact() ? "" : " (recorded before the game last changed, not exact)") << std::endl;
+	std::cout << "ticks: " << ticks << " (recorded " << replay.getTickCount() << ")" << std::endl;
+	std::cout << "outcome: " << static_cast<int> (outcome) << " (recorded " << static_cast<int> (replay.getOutcome()) << ")" << std::endl;
+	std::cout << "time: " << seconds << "s, " << (seconds > 0 ? ticks/seconds : 0) << " ticks/s" << std::endl;
+
+	if (ticks != replay.getTickCount() || outcome != replay.getOutcome())
+	{
+		if (!replay.isExact())
+		{
+			std::cerr << "Replay diverged from the recording, as expected of a version " << replay.getVersion() << " replay: the game has changed since it was recorded" << std::endl;
+
+			return 0;
 		}
+
+		std::cerr << "Replay diverged from the recording" << std::endl;
+
+		return 1;
 	}
 
-	void draw(sf::RenderTarget & target)
+	return 0;
+}
+
+struct BenchmarkResult
+{
+	std::string name;
+
+	long iterations;
+
+	double nanoseconds;
+
+	//written as extra fields, like Google Benchmark's user counters
+	std::vector<std::pair<std::string, double>> counters;
+};
+
+//times a function that runs a given number of iterations, growing the count
+//until one run takes long enough to measure, and writes the results in the
+//same JSON layout as Google Benchmark so existing comparison tools can read them
+class Benchmarks
+{
+	std::vector<BenchmarkResult> results;
+
+	double minimumSeconds;
+
+public:
+	//results are summed into this so the optimiser cannot drop the measured work
+	long sink;
+
+	Benchmarks(double minimumSeconds) : minimumSeconds(minimumSeconds), sink(0) {}
+
+	template <typename Function> void run(const std::string & name, Function function)
 	{
-		static sf::RectangleShape rectangle(sf::Vector2f(size, size));
+		long iterations = 1;
 
-		rectangle.setFillColor(sf::Color::Green);
+		double seconds = 0;
 
-		rectangle.setSize(sf::Vector2f(size, size));
+		while (true)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-		rectangle.setPosition(position);
+			function(iterations);
 
-		rectangle.setOrigin(rectangle.getSize().x/2, rectangle.getSize().y/2);
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-		target.draw(rectangle);
+			if (seconds >= minimumSeconds || iterations >= (1L << 40))
+				break;
+
+			//aim a little past the minimum so the next run is usually the last
+			double scale = seconds > 0 ? 1.4*minimumSeconds/seconds : 100;
+
+			iterations = std::max(iterations + 1, static_cast<long> (iterations*std::min(scale, 100.0)));
+		}
+
+		BenchmarkResult result = {name, iterations, seconds*1e9/iterations, {}};
+
+		results.push_back(result);
+
+		std::cout << std::left << std::setw(64) << name << std::right << std::setw(14) << std::fixed << std::setprecision(1) << result.nanoseconds << " ns" << std::setw(14) << iterations << std::endl;
 	}
 
-	sf::Vector2f getPosition() {return position;}
+	void add(const BenchmarkResult & result) {results.push_back(result);}
 
-	int getSize() {return size;}
+	const BenchmarkResult & getLast() {return results.back();}
+
+	//adds a counter to the result of the last run
+	void addCounter(const std::string & name, double value) {results.back().counters.push_back(std::make_pair(name, value));}
+
+	bool write(const std::string & path)
+	{
+		std::ofstream file(path);
+
+		if (!file)
+			return false;
+
+		file << "{\n  \"context\": {\n";
+		file << "    \"executable\": \"death-by-dots\",\n";
+		file << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef __VERSION__
+		file << "    \"compiler\": \"" << __VERSION__ << "\",\n";
+#endif
+#ifdef NDEBUG
+		file << "    \"library_build_type\": \"release\"\n";
+#else
+		file << "    \"library_build_type\": \"debug\"\n";
+#endif
+		file << "  },\n  \"benchmarks\": [\n";
+
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			file << "    {\"name\": \"" << results[i].name << "\", \"run_type\": \"iteration\", \"iterations\": " << results[i].iterations <<
+				", \"real_time\": " << std::setprecision(3) << results[i].nanoseconds << ", \"cpu_time\": " << results[i].nanoseconds << ", \"time_unit\": \"ns\"";
+
+			for (auto & counter : results[i].counters)
+				file << ", \"" << counter.first << "\": " << counter.second;
+
+			file << "}";
+
+			file << (i + 1 < results.size() ? ",\n" : "\n");
+		}
+
+		file << "  ]\n}\n";
+
+		return static_cast<bool> (file);
+	}
 };
 
-class MovingSpawningTurret
+std::string benchmarkName(const std::string & function, sf::Vector2i size, float density)
 {
-	float speed;
-	float spawnTime;
+	std::ostringstream stream;
+
+	stream << function << "/" << size.x << "x" << size.y << "/density:" << density;
+
+	return stream.str();
+}
+
+template <typename Grid>
+sf::Vector2f randomEmptyPoint(Grid & grid, Random & random)
+{
+	while (true)
+	{
+		int x = random.nextInt(grid.getSize().x);
+		int y = random.nextInt(grid.getSize().y);
+
+		if (!grid.isSolid(x, y))
+			return sf::Vector2f(x*grid.getBlockSize() + grid.getBlockSize()/2, y*grid.getBlockSize() + grid.getBlockSize()/2);
+	}
+}
+
+//the tile math heavy paths on the same blocks at a given tile size. Rays and
+//bullets are scaled with the tiles, so every size walks the same blocks
+template <int TileSize>
+void runTileSizeBenchmarks(Benchmarks & benchmarks, sf::Vector2i size)
+{
+	const std::string tile = "/tile:" + std::to_string(TileSize);
+
+	BasicBlockGrid<TileSize> grid(size);
+	Random random(7);
+
+	generate(grid, random);
+
+	std::vector<std::pair<sf::Vector2f, sf::Vector2f>> rays;
+
+	while (rays.size() < 1024)
+	{
+		sf::Vector2f from = randomEmptyPoint(grid, random);
+		sf::Vector2f to = randomEmptyPoint(grid, random);
+
+		if (distance(from, to) < 28*TileSize)
+			rays.push_back(std::make_pair(from, to));
+	}
+
+	benchmarks.run(benchmarkName("lineOfSight", size, 1/8.f) + tile, [&](long iterations)
+	{
+		for (long i = 0; i < iterations; ++i)
+			benchmarks.sink += lineOfSight(rays[i % rays.size()].first, rays[i % rays.size()].second, grid);
+	});
+
+	std::vector<Bullet> bullets;
+
+	for (int i = 0; i < 1000; ++i)
+		bullets.push_back(Bullet(randomEmptyPoint(grid, random), 10, 5.f*TileSize/25, random.nextFloat()*6.28f));
+
+	benchmarks.run(benchmarkName("bulletLifetime", size, 1/8.f) + "/bullets:1000" + tile, [&](long iterations)
+	{
+		float impact;
+		sf::Vector2i impactBlock;
+
+		for (long i = 0; i < iterations; ++i)
+			for (Bullet & bullet : bullets)
+				benchmarks.sink += bulletLifetime(bullet, grid, impact, impactBlock);
+	});
+
+	std::vector<std::uint8_t> inputs;
+
+	while (inputs.size() < 4096)
+	{
+		std::uint8_t input = random.nextInt(16);
+
+		for (int i = random.irandom_range(5, 30); i > 0; --i)
+			inputs.push_back(input);
+	}
+
+	Player player;
+
+	benchmarks.run(benchmarkName("Player::update", size, 1/8.f) + tile, [&](long iterations)
+	{
+		for (long i = 0; i < iterations; ++i)
+			player.update(grid, inputs[i % inputs.size()]);
+
+		benchmarks.sink += player.getPosition().x;
+	});
+}
+
+void runMicroBenchmarks(Benchmarks & benchmarks)
+{
+	const sf::Vector2i sizes[] = {sf::Vector2i(100, 35), sf::Vector2i(400, 140), sf::Vector2i(1600, 560)};
+	const float densities[] = {1/16.f, 1/8.f, 1/4.f};
+	const int bulletCounts[] = {100, 1000, 10000};
+	const int turretCounts[] = {10, 100, 1000};
+
+	const sf::Vector2i defaultSize(400, 140);
+
+	for (sf::Vector2i size : sizes)
+		for (float density : densities)
+		{
+			BlockGrid grid(size);
+			Random random(1);
+
+			generate(grid, random, density);
+
+			//turrets only test sight to a player that is on screen, so keep rays under a screen long
+			std::vector<std::pair<sf::Vector2f, sf::Vector2f>> rays;
+
+			while (rays.size() < 1024)
+			{
+				sf::Vector2f from = randomEmptyPoint(grid, random);
+				sf::Vector2f to = randomEmptyPoint(grid, random);
+
+				if (distance(from, to) < 700)
+					rays.push_back(std::make_pair(from, to));
+			}
+
+			benchmarks.run(benchmarkName("lineOfSight", size, density), [&](long iterations)
+			{
+				for (long i = 0; i < iterations; ++i)
+					benchmarks.sink += lineOfSight(rays[i % rays.size()].first, rays[i % rays.size()].second, grid);
+			});
+		}
+
+	//a screen of turrets all looking at one player, ray by ray and batched
+	for (float density : densities)
+		for (int turretCount : turretCounts)
+		{
+			BlockGrid grid(defaultSize);
+			Random random(9);
+
+			generate(grid, random, density);
+
+			sf::Vector2f target = randomEmptyPoint(grid, random);
 
-	sf::Vector2f position;
+			std::vector<sf::Vector2f> eyes;
 
-	int size;
-	int shotsPerSecond;
-	
-	bool canShoot;
+			while (eyes.size() < static_cast<std::size_t> (turretCount))
+			{
+				sf::Vector2f eye = randomEmptyPoint(grid, random);
 
-	sf::Clock clock;
-	sf::Clock spawnClock;
+				if (std::abs(eye.x - target.x) < 350 && std::abs(eye.y - target.y) < 350)
+					eyes.push_back(eye);
+			}
 
-	void shoot(sf::Vector2f target, std::vector<Bullet> & bullets)
-	{
-		float angle = pointDirection(position, target);
+			std::vector<std::uint8_t> sight(eyes.size());
 
-		bullets.push_back(Bullet(position, 10, 5, angle));
-	}
+			benchmarks.run(benchmarkName("lineOfSight", defaultSize, density) + "/turrets:" + std::to_string(turretCount), [&](long iterations)
+			{
+				for (long i = 0; i < iterations; ++i)
+					for (std::size_t eye = 0; eye < eyes.size(); ++eye)
+						sight[eye] = lineOfSight(eyes[eye], target, grid);
 
-public:
-	MovingSpawningTurret(sf::Vector2f position, float speed, float spawnTime, int shotsPerSecond) : position(position), speed(speed), spawnTime(spawnTime), shotsPerSecond(shotsPerSecond), canShoot(false), size(10)
-	{
+				benchmarks.sink += sight[0];
+			});
 
-	}
+			benchmarks.run(benchmarkName("lineOfSightBatch", defaultSize, density) + "/turrets:" + std::to_string(turretCount), [&](long iterations)
+			{
+				for (long i = 0; i < iterations; ++i)
+					lineOfSightBatch(eyes.data(), eyes.size(), target, grid, sight.data());
+
+				benchmarks.sink += sight[0];
+			});
+		}
 
-	void update(sf::Vector2f target, std::vector<MovingSpawningTurret> & turrets, std::vector<Bullet> & bullets, BlockGrid & grid)
+	for (float density : densities)
 	{
-		if (target == sf::Vector2f(0, 0))
-			return;
+		BlockGrid grid(defaultSize);
+		Random random(2);
 
-		bool hasLineOfSight = lineOfSight(position, target, grid);
+		generate(grid, random, density);
 
-		if (canShoot && hasLineOfSight)
+		for (int bulletCount : bulletCounts)
 		{
-			canShoot = false;
+			std::vector<Bullet> bullets;
 
-			clock.restart();
+			for (int i = 0; i < bulletCount; ++i)
+			{
+				bullets.push_back(Bullet(randomEmptyPoint(grid, random), 10, 5, random.nextFloat()*6.28f));
 
-			shoot(target, bullets);
-		}
+				bullets.back().update();
+			}
 
-		if (!canShoot && shotsPerSecond != 0)
-		{
-			if (clock.getElapsedTime().asSeconds() > 1/shotsPerSecond)
-				canShoot = true;
-		}
+			benchmarks.run(benchmarkName("bulletGridCollision", defaultSize, density) + "/bullets:" + std::to_string(bulletCount), [&](long iterations)
+			{
+				for (long i = 0; i < iterations; ++i)
+					for (Bullet & bullet : bullets)
+						benchmarks.sink += bulletGridCollision(bullet.getPreviousPosition(), bullet.getPosition(), bullet.getSize(), grid);
+			});
 
-		if (spawnClock.getElapsedTime().asSeconds() > spawnTime)
-		{
-			spawnClock.restart();
+			benchmarks.run(benchmarkName("bulletLifetime", defaultSize, density) + "/bullets:" + std::to_string(bulletCount), [&](long iterations)
+			{
+				float impact;
+				sf::Vector2i impactBlock;
 
-			Random random;
+				for (long i = 0; i < iterations; ++i)
+					for (Bullet & bullet : bullets)
+						benchmarks.sink += bulletLifetime(bullet, grid, impact, impactBlock);
+			});
+		}
+	}
 
-			std::vector<sf::Vector2i> emptyBlocks;
+	for (int bulletCount : bulletCounts)
+	{
+		Random random(3);
 
-			int leftBound = (position.x - 100)/grid.getBlockSize();
-			int topBound = (position.y - 100)/grid.getBlockSize();
-			int rightBound = (position.x + std::ceil(100))/grid.getBlockSize();
-			int bottomBound = (position.y + std::ceil(100))/grid.getBlockSize();
+		Player player;
 
-			if (leftBound < 0)
-				leftBound = 0;
+		std::vector<Bullet> bullets;
 
-			if (rightBound >= grid.getSize().x)
-				rightBound = grid.getSize().x - 2;
+		for (int i = 0; i < bulletCount; ++i)
+			bullets.push_back(Bullet(sf::Vector2f(random.nextFloat()*700, random.nextFloat()*700), 10, 5, 0));
 
-			if (topBound < 0)
-				topBound = 0;
+		benchmarks.run("playerBulletCollision/bullets:" + std::to_string(bulletCount), [&](long iterations)
+		{
+			for (long i = 0; i < iterations; ++i)
+				for (Bullet & bullet : bullets)
+					benchmarks.sink += playerBulletCollision(player.getPosition(), player, bullet, 1);
+		});
+	}
 
-			if (bottomBound >= grid.getSize().y)
-				bottomBound = grid.getSize().y - 1;
+	for (float density : densities)
+	{
+		BlockGrid grid(defaultSize);
+		Random random(4);
 
-			for (int x = leftBound; x < rightBound; ++x)
-				for (int y = topBound; y < bottomBound; ++y)
-					if (!grid.isSolid(x, y))
-						emptyBlocks.push_back(sf::Vector2i(x, y));
+		generate(grid, random, density);
 
-			if (!emptyBlocks.empty())
-			{
-				int randomIndex = random.nextInt(emptyBlocks.size());
+		std::vector<std::uint8_t> inputs;
 
-				sf::Vector2f position(emptyBlocks[randomIndex].x*grid.getBlockSize() + grid.getBlockSize()/2, emptyBlocks[randomIndex].y*grid.getBlockSize() + grid.getBlockSize()/2);
+		//held keys change every few ticks like a real player's would
+		while (inputs.size() < 4096)
+		{
+			std::uint8_t input = random.nextInt(16);
 
-				turrets.push_back(MovingSpawningTurret(position, 1, 1, 1));
-			}
+			for (int i = random.irandom_range(5, 30); i > 0; --i)
+				inputs.push_back(input);
 		}
 
-		if (!(distance(position, target) < 100 && hasLineOfSight))
+		Player player;
+
+		benchmarks.run(benchmarkName("Player::update", defaultSize, density), [&](long iterations)
 		{
-			sf::Vector2f cornerPosition;
+			for (long i = 0; i < iterations; ++i)
+				player.update(grid, inputs[i % inputs.size()]);
 
-			cornerPosition.x = position.x - size/2;
-			cornerPosition.y = position.y - size/2;
+			benchmarks.sink += player.getPosition().x;
+		});
+	}
 
-			int xMove = target.x - position.x;
-			int yMove = target.y - position.y;
+	for (float density : densities)
+		for (int turretCount : turretCounts)
+		{
+			BlockGrid grid(defaultSize);
+			Random random(5);
 
-			if (std::abs(xMove) > speed)
-				xMove = xMove > 0 ? speed : -speed;
+			generate(grid, random, density);
 
-			if (std::abs(yMove) > speed)
-				yMove = yMove > 0 ? speed : -speed;
+			std::vector<MovingTurret> turrets;
 
-			int prevX = position.x;
-			int prevY = position.y;
+			for (int i = 0; i < turretCount; ++i)
+				turrets.push_back(MovingTurret(randomEmptyPoint(grid, random), 1, 1));
 
-			for (int i = 0; i < std::abs(xMove); ++i)
-			{
-				int increment = sign(xMove);
+			BulletStore bullets(grid);
 
-				position.x += increment;
+			sf::Vector2f target = randomEmptyPoint(grid, random);
 
-				std::vector<sf::Vector2i> blocks;
+			std::uint32_t tick = 0;
 
-				blocks.push_back(sf::Vector2i((position.x - size/2)/grid.getBlockSize(), (position.y - size/2)/grid.getBlockSize()));
-				blocks.push_back(sf::Vector2i(std::ceil((position.x + size/2) /grid.getBlockSize()), std::ceil((position.y + size/2)/grid.getBlockSize())));
-				blocks.push_back(sf::Vector2i(std::ceil((position.x + size/2)/grid.getBlockSize()), (position.y - size/2)/grid.getBlockSize()));
-				blocks.push_back(sf::Vector2i((position.x - size/2)/grid.getBlockSize(), std::ceil((position.y + size/2)/grid.getBlockSize())));
+			std::vector<sf::Vector2f> eyes(turrets.size());
+			std::vector<std::uint8_t> sight(turrets.size());
 
-				if (position.x < 0 || position.x > grid.getBlockSize()*grid.getSize().x - size)
+			benchmarks.run(benchmarkName("MovingTurret::update", defaultSize, density) + "/turrets:" + std::to_string(turretCount), [&](long iterations)
+			{
+				for (long i = 0; i < iterations; ++i)
 				{
-					position.x = prevX;
+					for (std::size_t turret = 0; turret < turrets.size(); ++turret)
+						eyes[turret] = turrets[turret].getPosition();
 
-					break;
-				}
+					lineOfSightBatch(eyes.data(), eyes.size(), target, grid, sight.data());
 
-				for (auto block : blocks)
-					if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
-					{
-						position.x = prevX;
+					for (std::size_t turret = 0; turret < turrets.size(); ++turret)
+						turrets[turret].update(target, sight[turret], bullets, grid, tick);
 
-						break;
-					}
+					++tick;
 
-				prevX = position.x;
-			}
+					bullets.clear();
+				}
+			});
+		}
 
-			for (int i = 0; i < std::abs(yMove); ++i)
-			{
-				int increment = sign(yMove);
+	//the pushes keeping a crowd of moving turrets apart, found through the
+	//CrowdGrid and by checking every pair, with every turret shuffling a pixel
+	//a tick so some of them change cells
+	for (int turretCount : {256, 1024, 4096})
+	{
+		BlockGrid grid(defaultSize);
+		Random random(7);
 
-				position.y += increment;
+		const sf::Vector2i pixels(defaultSize.x*grid.getBlockSize(), defaultSize.y*grid.getBlockSize());
 
-				std::vector<sf::Vector2i> blocks;
+		std::vector<sf::Vector2f> positions;
 
-				blocks.push_back(sf::Vector2i((position.x - size/2)/grid.getBlockSize(), (position.y - size/2)/grid.getBlockSize()));
-				blocks.push_back(sf::Vector2i(std::ceil((position.x + size/2) /grid.getBlockSize()), std::ceil((position.y + size/2)/grid.getBlockSize())));
-				blocks.push_back(sf::Vector2i(std::ceil((position.x + size/2)/grid.getBlockSize()), (position.y - size/2)/grid.getBlockSize()));
-				blocks.push_back(sf::Vector2i((position.x - size/2)/grid.getBlockSize(), std::ceil((position.y + size/2)/grid.getBlockSize())));
+		for (int i = 0; i < turretCount; ++i)
+			positions.push_back(sf::Vector2f(random.nextFloat()*pixels.x, random.nextFloat()*pixels.y));
 
-				if (position.y < 0 || position.y > grid.getBlockSize()*grid.getSize().y - size)
-				{
-					position.y = prevY;
+		CrowdGrid crowd;
 
-					break;
-				}
+		crowd.reset(pixels, positions.size());
 
-				for (auto block : blocks)
-					if (block.x < grid.getSize().x && block.y < grid.getSize().y && block.x >= 0 && block.y >= 0 && grid.isSolid(block.x, block.y))
-					{
-						position.y = prevY;
+		for (std::size_t turret = 0; turret < positions.size(); ++turret)
+			crowd.place(turret, positions[turret]);
 
-						break;
-					}
+		std::uint32_t tick = 0;
+		long pushes = 0;
 
-				prevY = position.y;
-			}
+		auto shuffle = [&](std::size_t turret)
+		{
+			const float step = ((turret + tick) % 3) - 1.f;
 
-			/*position = cornerPosition;
+			positions[turret].x = std::max(0.f, std::min(pixels.x - 1.f, positions[turret].x + step));
+		};
 
-			int extra = (size/2) % 2 == 0 ? 0 : 1;
+		benchmarks.run("CrowdGrid::separation/turrets:" + std::to_string(turretCount), [&](long iterations)
+		{
+			for (long i = 0; i < iterations; ++i)
+			{
+				for (std::size_t turret = 0; turret < positions.size(); ++turret)
+				{
+					shuffle(turret);
 
-			position.x += size/2 + extra;
-			position.y += size/2 + extra;*/
-		}
-	}
+					crowd.move(turret, positions[turret]);
 
-	void draw(sf::RenderTarget & target)
-	{
-		static sf::RectangleShape rectangle(sf::Vector2f(size, size));
+					sf::Vector2i push = crowd.separation(turret, 20);
 
-		rectangle.setFillColor(sf::Color::Magenta);
+					pushes += push.x != 0 || push.y != 0;
+				}
 
-		rectangle.setSize(sf::Vector2f(size, size));
+				++tick;
+			}
+		});
 
-		rectangle.setPosition(position);
+		benchmarks.addCounter("crowd_bytes", crowd.getMemory());
+		benchmarks.addCounter("pushed_per_tick", double(pushes)/tick);
 
-		rectangle.setOrigin(rectangle.getSize().x/2, rectangle.getSize().y/2);
+		pushes = 0;
+		tick = 0;
 
-		target.draw(rectangle);
-	}
+		benchmarks.run("allPairsSeparation/turrets:" + std::to_string(turretCount), [&](long iterations)
+		{
+			for (long i = 0; i < iterations; ++i)
+			{
+				for (std::size_t turret = 0; turret < positions.size(); ++turret)
+				{
+					shuffle(turret);
 
-	sf::Vector2f getPosition() {return position;}
+					sf::Vector2i push(0, 0);
 
-	int getSize() {return size;}
-};
+					for (std::size_t other = 0; other < positions.size(); ++other)
+						if (other != turret && std::abs(positions[other].x - positions[turret].x) < 20 && std::abs(positions[other].y - positions[turret].y) < 20)
+						{
+							push.x += sign(positions[turret].x - positions[other].x);
+							push.y += sign(positions[turret].y - positions[other].y);
+						}
 
-class Player
-{
-	sf::Vector2f position;
+					pushes += push.x != 0 || push.y != 0;
+				}
 
-	int size;
+				++tick;
+			}
+		});
 
-public:
-	Player() : position(0, 0), size(25) {}
+		benchmarks.addCounter("pushed_per_tick", double(pushes)/tick);
+	}
 
-	void update(BlockGrid & grid)
+	//turrets firing every pattern together, a tenth of them each tick, with the
+	//bullets moving and retiring as they would in a game
+	for (int pattern = 0; pattern < emitterPatternCount; ++pattern)
 	{
-		int xMove = 0;
-		int yMove = 0;
+		const int turretCount = 200;
 
-		int prevX = position.x;
-		int prevY = position.y;
+		BlockGrid grid(defaultSize);
+		Random random(6);
 
-		int moveAmount = 3;
+		generate(grid, random, 1/8.f);
 
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left) || sf::Keyboard::isKeyPressed(sf::Keyboard::A))
-			xMove = -moveAmount;
+		std::vector<sf::Vector2f> positions;
+		std::vector<Emitter> emitters(turretCount, Emitter(pattern));
 
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right) || sf::Keyboard::isKeyPressed(sf::Keyboard::D))
-			xMove = moveAmount;
+		for (int i = 0; i < turretCount; ++i)
+			positions.push_back(randomEmptyPoint(grid, random));
 
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up) || sf::Keyboard::isKeyPressed(sf::Keyboard::W))
-			yMove = -moveAmount;
+		BulletStore bullets(grid);
+		std::vector<sf::Vector2i> impacts;
 
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down) || sf::Keyboard::isKeyPressed(sf::Keyboard::S))
-			yMove = moveAmount;
+		sf::Vector2f target = randomEmptyPoint(grid, random);
 
-		
+		std::uint32_t tick = 0;
 
-		for (int i = 0; i < std::abs(xMove); ++i)
+		benchmarks.run(benchmarkName("Emitter", defaultSize, 1/8.f) + "/" + emitterPatterns[pattern].name + "/turrets:" + std::to_string(turretCount), [&](long iterations)
 		{
-			int increment = sign(xMove);
-
-			position.x += increment;
-
-			std::vector<sf::Vector2i> blocks;
-
-			blocks.push_back(sf::Vector2i(position.x/grid.getBlockSize(), position.y/grid.getBlockSize()));
-			blocks.push_back(sf::Vector2i(std::ceil(position.x/grid.getBlockSize()), std::ceil(position.y/grid.getBlockSize())));
-			blocks.push_back(sf::Vector2i(std::ceil(position.x/grid.getBlockSize()), position.y/grid.getBlockSize()));
-			blocks.push_back(sf::Vector2i(position.x/grid.getBlockSize(), std::ceil(position.y/grid.getBlockSize())));
-
-			if (position.x < 0 || position.x > grid.getBlockSize()*grid.getSize().x - size)
+			for (long i = 0; i < iterations; ++i)
 			{
-				position.x = prevX;
+				bullets.setTick(++tick);
 
-				break;
-			}
+				for (Bullet & bullet : bullets)
+					bullet.update();
 
-			for (auto block : blocks)
-				if (grid.isSolid(block.x, block.y))
+				for (int turret = 0; turret < turretCount; ++turret)
 				{
-					position.x = prevX;
+					if ((tick + turret) % 10 == 0)
+						emitters[turret].fire(tick);
 
-					break;
+					emitters[turret].update(positions[turret], target, bullets, tick);
 				}
 
-			prevX = position.x;
-		}
-
-		for (int i = 0; i < std::abs(yMove); ++i)
-		{
-			int increment = sign(yMove);
+				impacts.clear();
 
-			position.y += increment;
+				bullets.retire(impacts);
+			}
+		});
 
-			std::vector<sf::Vector2i> blocks;
+		double bulletsPerTick = double(bullets.getSpawnedCount())/tick;
 
-			blocks.push_back(sf::Vector2i(position.x/grid.getBlockSize(), position.y/grid.getBlockSize()));
-			blocks.push_back(sf::Vector2i(std::ceil(position.x/grid.getBlockSize()), std::ceil(position.y/grid.getBlockSize())));
-			blocks.push_back(sf::Vector2i(std::ceil(position.x/grid.getBlockSize()), position.y/grid.getBlockSize()));
-			blocks.push_back(sf::Vector2i(position.x/grid.getBlockSize(), std::ceil(position.y/grid.getBlockSize())));
+		benchmarks.addCounter("bullets_per_tick", bulletsPerTick);
+		benchmarks.addCounter("bullets_per_second", bulletsPerTick*1e9/benchmarks.getLast().nanoseconds);
+	}
 
-			if (position.y < 0 || position.y > grid.getBlockSize()*grid.getSize().y - size)
+	for (sf::Vector2i size : sizes)
+	{
+		benchmarks.run(benchmarkName("generate", size, 1/8.f), [&](long iterations)
+		{
+			for (long i = 0; i < iterations; ++i)
 			{
-				position.y = prevY;
+				BlockGrid grid(size);
+				Random random(i);
 
-				break;
+				generate(grid, random);
+
+				benchmarks.sink += grid.isSolid(size.x/2, size.y/2);
 			}
+		});
+	}
 
-			for (auto block : blocks)
-				if (grid.isSolid(block.x, block.y))
-				{
-					position.y = prevY;
+	//the check generate makes that a level can be crossed, on the usual shapes,
+	//a very wide one, and one dense enough that it usually fails part way
+	for (sf::Vector2i size : {sizes[0], sizes[1], sizes[2], sf::Vector2i(100000, 35)})
+		for (float density : {1/8.f, 1/2.f})
+		{
+			BlockGrid grid(size);
+			Random random(6);
 
-					break;
-				}
+			generate(grid, random, density);
 
-			prevY = position.y;
+			int crossable = 0;
+
+			benchmarks.run(benchmarkName("BlockGrid::connects", size, density), [&](long iterations)
+			{
+				for (long i = 0; i < iterations; ++i)
+					crossable += grid.connects(0, size.x - 1);
+			});
+
+			benchmarks.addCounter("crossable", crossable > 0);
 		}
-	}
 
-	void draw(sf::RenderTarget & target)
+	for (sf::Vector2i size : sizes)
 	{
-		static sf::RectangleShape rectangle(sf::Vector2f(size, size));
+		BlockGrid grid(size);
+		Random random(6);
 
-		rectangle.setFillColor(sf::Color::Red);
+		generate(grid, random);
 
-		rectangle.setPosition(position);
+		//a subset of the whole grid copies every block and builds its distance field again
+		benchmarks.run(benchmarkName("BlockGrid::getSubset", size, 1/8.f), [&](long iterations)
+		{
+			for (long i = 0; i < iterations; ++i)
+				benchmarks.sink += grid.getSubset(sf::FloatRect(0, 0, size.x*grid.getBlockSize(), size.y*grid.getBlockSize())).getDistance(size.x/2, size.y/2);
+		});
 
-		target.draw(rectangle);
-	}
+		//a screen of blocks counted through an owning copy and through a view
+		sf::FloatRect screen(size.x*grid.getBlockSize()/2, 0, 800, 700);
 
-	int getSize() {return size;}
+		benchmarks.run(benchmarkName("BlockGrid::getSubset", size, 1/8.f) + "/screen", [&](long iterations)
+		{
+			for (long i = 0; i < iterations; ++i)
+			{
+				BlockGrid subset = grid.getSubset(screen);
 
-	sf::Vector2f getPosition() {return position;}
-};
+				benchmarks.sink += subset.countEmpty(0, 0, subset.getSize().x, subset.getSize().y);
+			}
+		});
 
-	
+		benchmarks.run(benchmarkName("BlockGrid::getView", size, 1/8.f) + "/screen", [&](long iterations)
+		{
+			for (long i = 0; i < iterations; ++i)
+			{
+				BlockGridView view = grid.getView(screen);
 
-float pointDirection(sf::Vector2f looker, sf::Vector2f target)
-{
-	return 3.12 + std::atan2(looker.y - target.y, looker.x - target.x);
-}
+				benchmarks.sink += view.countEmpty(0, 0, view.getSize().x, view.getSize().y);
+			}
+		});
+	}
 
-float distance(sf::Vector2f point1, sf::Vector2f point2)
-{
-	return std::sqrt(std::pow(point1.x - point2.x, 2) + std::pow(point1.y - point2.y, 2));
-}
+	for (sf::Vector2i size : sizes)
+		for (float density : densities)
+		{
+			BlockGrid grid(size);
+			Random random(6);
 
-bool bulletGridCollision(Bullet bullet, BlockGrid & blockGrid, int blockSize)
-{
-	int leftBound = (bullet.getPosition().x - bullet.getSize()/2.f)/blockGrid.getBlockSize();
-	int topBound = (bullet.getPosition().y - bullet.getSize()/2.f)/blockGrid.getBlockSize();
-	int rightBound = (bullet.getPosition().x + std::ceil(bullet.getSize()/2.f))/blockGrid.getBlockSize();
-	int bottomBound = (bullet.getPosition().y + std::ceil(bullet.getSize()/2.f))/blockGrid.getBlockSize();
+			generate(grid, random, density);
 
-	std::vector<sf::Vector2i> blocks;
+			benchmarks.run(benchmarkName("populateTurrets", size, density), [&](long iterations)
+			{
+				std::vector<Turret> turrets;
 
-	for (int x = leftBound; x < rightBound; ++x)
-		for (int y = topBound; y < bottomBound; ++y)
-			blocks.push_back(sf::Vector2i(x, y));
+				for (long i = 0; i < iterations; ++i)
+				{
+					turrets.clear();
 
-	for (auto block : blocks)
-		if (blockGrid.isSolid(block.x, block.y))
-			return true;
+					populateTurrets(turrets, grid, random);
+				}
 
-	return false;
-	
+				benchmarks.sink += turrets.size();
+			});
 
-	//return blockGrid.isSolid(static_cast<int> (bullet.getPosition().x/blockSize), static_cast<int> (bullet.getPosition().y/blockSize));
-}
+			benchmarks.run(benchmarkName("populateMovingTurrets", size, density), [&](long iterations)
+			{
+				std::vector<MovingTurret> turrets;
 
-bool playerBulletCollision(Player player, Bullet bullet)
-{
-	sf::FloatRect playerRect;
+				for (long i = 0; i < iterations; ++i)
+				{
+					turrets.clear();
 
-	playerRect.left = player.getPosition().x;
-	playerRect.top = player.getPosition().y;
+					populateMovingTurrets(turrets, grid, random);
+				}
 
-	playerRect.width = player.getSize();
-	playerRect.height = player.getSize();
+				benchmarks.sink += turrets.size();
+			});
+		}
 
-	sf::FloatRect bulletRect;
+	runTileSizeBenchmarks<25>(benchmarks, defaultSize);
+	runTileSizeBenchmarks<32>(benchmarks, defaultSize);
 
-	bulletRect.left = bullet.getPosition().x - bullet.getSize()/2.f;
-	bulletRect.top = bullet.getPosition().y - bullet.getSize()/2.f;
+	//the same blocks kept as bits and as runs, with what each grid takes up
+	const std::pair<BlockStorage, std::string> storages[] = {{BlockStorage::Bits, "/storage:bits"}, {BlockStorage::Runs, "/storage:runs"}};
 
-	bulletRect.width = bullet.getSize();
-	bulletRect.height = bullet.getSize();
+	for (sf::Vector2i size : sizes)
+		for (float density : {1/64.f, 1/8.f})
+			for (auto & storage : storages)
+			{
+				BlockGrid grid(size, storage.first);
+				Random random(8);
 
-	if (playerRect.intersects(bulletRect))
-		return true;
-	else
-		return false;
-}
+				generate(grid, random, density);
 
-template <typename T> int sign(T val) {
-    return (T(0) < val) - (val < T(0));
-}
+				std::vector<sf::Vector2i> blocks;
 
-void populateTurrets(std::vector<Turret> & turrets, BlockGrid & grid)
-{
-	std::vector<sf::Vector2i> emptyBlocks;
+				for (int i = 0; i < 4096; ++i)
+					blocks.push_back(sf::Vector2i(random.nextInt(size.x), random.nextInt(size.y)));
 
-	for (int x = 3; x < grid.getSize().x - 4; ++x)
-		for (int y = 0; y < grid.getSize().y; ++y)
-			if (!grid.isSolid(x, y))
-				emptyBlocks.push_back(sf::Vector2i(x, y));
-		
+				benchmarks.run(benchmarkName("BlockGrid::isSolid", size, density) + storage.second, [&](long iterations)
+				{
+					for (long i = 0; i < iterations; ++i)
+						benchmarks.sink += grid.isSolid(blocks[i % blocks.size()].x, blocks[i % blocks.size()].y);
+				});
 
-	Random random;
+				BlockGridMemory memory = grid.getMemory();
 
-	for (auto block : emptyBlocks)
-		if (random.irandom_range(0, 64) == 0)
-			turrets.push_back(Turret(sf::Vector2f(block.x*grid.getBlockSize() + grid.getBlockSize()/2, block.y*grid.getBlockSize() + grid.getBlockSize()/2), 1));
-}
+				benchmarks.addCounter("blocks_bytes", memory.blocks);
+				benchmarks.addCounter("distances_bytes", memory.distances);
+				benchmarks.addCounter("pyramid_bytes", memory.pyramid);
 
-void populateMovingTurrets(std::vector<MovingTurret> & turrets, BlockGrid & grid)
-{
-	std::vector<sf::Vector2i> emptyBlocks;
+				std::cout << "    blocks " << memory.blocks/1024.0 << " KB, distances " << memory.distances/1024.0 << " KB, pyramid " << memory.pyramid/1024.0 << " KB" << std::endl;
 
-	for (int x = 3; x < grid.getSize().x - 4; ++x)
-		for (int y = 0; y < grid.getSize().y; ++y)
-			if (!grid.isSolid(x, y))
-				emptyBlocks.push_back(sf::Vector2i(x, y));
-		
+				//every solid block of a screen, as drawing a level does
+				benchmarks.run(benchmarkName("BlockGrid::forEachSolidRun", size, density) + storage.second + "/screen", [&](long iterations)
+				{
+					for (long i = 0; i < iterations; ++i)
+						grid.forEachSolidRun(size.x/2, 0, size.x/2 + 32, 28, [&](int, int top, int bottom) {benchmarks.sink += bottom - top;});
+				});
 
-	Random random;
+				std::vector<Bullet> bullets;
+
+				for (int i = 0; i < 1000; ++i)
+				{
+					bullets.push_back(Bullet(randomEmptyPoint(grid, random), 10, 5, random.nextFloat()*6.28f));
+
+					bullets.back().update();
+				}
 
-	for (auto block : emptyBlocks)
-		if (random.irandom_range(0, 500) == 0)
-			turrets.push_back(MovingTurret(sf::Vector2f(block.x*grid.getBlockSize() + grid.getBlockSize()/2, block.y*grid.getBlockSize() + grid.getBlockSize()/2), 1, 1));
+				benchmarks.run(benchmarkName("bulletGridCollision", size, density) + storage.second + "/bullets:1000", [&](long iterations)
+				{
+					for (long i = 0; i < iterations; ++i)
+						for (Bullet & bullet : bullets)
+							benchmarks.sink += bulletGridCollision(bullet.getPreviousPosition(), bullet.getPosition(), bullet.getSize(), grid);
+				});
+			}
 }
 
-void populateMovingSpawningTurrets(std::vector<MovingSpawningTurret> & turrets, BlockGrid & grid)
+//peak resident memory of the whole process in bytes, 0 where it is unknown
+std::size_t peakMemory()
 {
-	std::vector<sf::Vector2i> emptyBlocks;
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
 
-	for (int x = 3; x < grid.getSize().x - 4; ++x)
-		for (int y = 0; y < grid.getSize().y; ++y)
-			if (!grid.isSolid(x, y))
-				emptyBlocks.push_back(sf::Vector2i(x, y));
-		
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
 
-	Random random;
+	return 0;
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
 
-	for (auto block : emptyBlocks)
-		if (random.irandom_range(0, 500) == 0)
-			turrets.push_back(MovingSpawningTurret(sf::Vector2f(block.x*grid.getBlockSize() + grid.getBlockSize()/2, block.y*grid.getBlockSize() + grid.getBlockSize()/2), 1, 1, 1));
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return usage.ru_maxrss*1024L;
+#endif
+#endif
 }
 
-bool lineOfSight(sf::Vector2f point1, sf::Vector2f point2, BlockGrid & grid)
+//stands in for a person: heads for the finish and picks a way up or down when a wall stops it
+class ScriptedPlayer
 {
-	float angle = pointDirection(point1, point2);
-
-	for (float distanceWalked = 0; distanceWalked < distance(point1, point2); distanceWalked += 0.9)
-	{
-		int posX = point1.x + std::cos(angle)*distanceWalked;
-		int posY = point1.y + std::sin(angle)*distanceWalked;
+	Random random;
 
-		if (grid.isSolid(posX/grid.getBlockSize(), posY/grid.getBlockSize()))
-			return false;
-	}
+	sf::Vector2f lastPosition;
 
-	return true;
-}
+	int stuckTicks;
+	int detourTicks;
 
-class MainMenuScreen : public Screen
-{
-	sf::Text titleText;
-	sf::Text quitText;
-	sf::Text playText;
-	sf::Text instructionsText;
+	std::uint8_t detour;
 
-	sf::Font * font;
 public:
-	MainMenuScreen(sf::Vector2i windowSize, sf::Font & font);
+	ScriptedPlayer(std::uint32_t seed) : random(seed), stuckTicks(0), detourTicks(0), detour(InputUp) {}
 
-	Screen * update(sf::RenderWindow & window);
+	std::uint8_t next(GameScreen & game)
+	{
+		sf::Vector2f position = game.getPlayerPosition();
 
-	void draw(sf::RenderTarget & target);
-};
+		stuckTicks = position.x == lastPosition.x ? stuckTicks + 1 : 0;
 
-class InstructionsScreen : public Screen
-{
-	sf::Text titleText;
-	sf::Text backText;
-	sf::Text playerText;
-	sf::Text bulletText;
-	sf::Text turretText;
-	sf::Text movingTurretText;
-	sf::Text safeZoneText;
-	sf::Text finishZoneText;
+		lastPosition = position;
 
-	sf::RectangleShape playerRectangle;
-	sf::RectangleShape bulletRectangle;
-	sf::RectangleShape turretRectangle;
-	sf::RectangleShape movingTurretRectangle;
-	sf::RectangleShape safeZoneRectangle;
-	sf::RectangleShape finishZoneRectangle;
+		if (detourTicks > 0)
+		{
+			--detourTicks;
 
-	sf::Font * font;
+			return detour;
+		}
 
-	sf::Vector2f windowSize;
-public:
-	InstructionsScreen(sf::Vector2i windowSize, sf::Font & font);
+		if (stuckTicks > 5)
+		{
+			detour = random.nextBool() ? InputUp : InputDown;
 
-	Screen * update(sf::RenderWindow & window);
-	void draw(sf::RenderTarget & target);
+			detourTicks = random.irandom_range(5, 25);
 
+			stuckTicks = 0;
+		}
+
+		return InputRight;
+	}
 };
 
-class DeadScreen : public Screen
+struct GameBenchmarkSettings
 {
-	sf::Text diedText;
-	sf::Text explanationText;
-	sf::Text backText;
+	std::uint32_t firstSeed;
+	std::uint32_t lastSeed;
 
-	sf::Font * font;
+	std::vector<sf::Vector2i> gridSizes;
 
-	sf::Vector2i windowSize;
+	std::vector<float> turretDensities;
 
-public:
-	DeadScreen(sf::Vector2i windowSize, sf::Font & font);
+	//games that end sooner are restarted until they have run this many ticks
+	std::uint32_t ticksPerGame;
 
-	Screen * update(sf::RenderWindow & window);
+	std::vector<std::string> replayPaths;
 
-	void draw(sf::RenderTarget & target);
-};
+	bool destructible;
 
-class WinScreen : public Screen
-{
-	sf::Text winText;
-	sf::Text explanationText;
-	sf::Text backText;
+	BlockStorage blockStorage;
 
-	sf::Font * font;
+	SimulationDetail detail;
 
-	sf::Vector2i windowSize;
+	//milliseconds a tick may take before the scripted games give up fidelity,
+	//zero to always play at full fidelity
+	float frameBudget;
 
-public:
-	WinScreen(sf::Vector2i windowSize, sf::Font & font);
+	bool patterns;
+	bool crowd;
 
-	Screen * update(sf::RenderWindow & window);
+	//how many games --bench batch plays at once, each count in turn
+	std::vector<unsigned> threadCounts;
 
-	void draw(sf::RenderTarget & target);
+	GameBenchmarkSettings() : firstSeed(1), lastSeed(10), gridSizes({sf::Vector2i(100, 35), sf::Vector2i(400, 140)}), turretDensities({1, 4}), ticksPerGame(3000), destructible(false), blockStorage(BlockStorage::Bits), frameBudget(0), patterns(false), crowd(false), threadCounts({std::max(1u, std::thread::hardware_concurrency())}) {}
 };
 
-class GameScreen : public Screen
+struct GameStatistics
 {
-	std::vector<Bullet> bullets;
-	std::vector<Turret> turrets;
-	std::vector<MovingTurret> movingTurrets;
-	//std::vector<MovingSpawningTurret> movingSpawningTurrets;
+	std::vector<float> tickMicroseconds;
 
-	std::vector<Turret *> activeTurrets;
-	std::vector<MovingTurret *> activeMovingTurrets;
-	//std::vector<MovingSpawningTurret *> activeMovingSpawningTurrets;
+	std::size_t peakBullets;
+	std::uint64_t spawnedBullets;
 
-	Player player;
+	std::size_t arenaHighWaterMark;
 
-	BlockGrid blockGrid;
+	//the largest grid of the games run
+	std::size_t gridBytes;
 
-	sf::FloatRect activeBounds;
+	//ticks played below full fidelity, and the budget the governor holds them to
+	std::size_t governedTicks;
+	float frameBudget;
 
-	sf::View view;
+	GameStatistics(float frameBudget = 0) : peakBullets(0), spawnedBullets(0), arenaHighWaterMark(0), gridBytes(0), governedTicks(0), frameBudget(frameBudget) {}
 
-	std::vector<int> startRectanglePositions;
-	std::vector<sf::RectangleShape> rectangles;
-	sf::RectangleShape startRectangle;
-	sf::RectangleShape endRectangle;
+	template <typename Input> void run(GameScreen & game, std::uint32_t ticks, Input input)
+	{
+		FrameGovernor governor(frameBudget);
 
-	sf::Font * font;
+		std::uint64_t spawnedBefore = game.getSpawnedBulletCount();
 
-public:
-	GameScreen(const sf::RenderWindow & window, sf::Font & font) : blockGrid(sf::Vector2i(100, window.getSize().y/20)), view(window.getDefaultView()), startRectangle(sf::Vector2f(blockGrid.getBlockSize()*3, blockGrid.getSize().y*blockGrid.getBlockSize())), endRectangle(sf::Vector2f(blockGrid.getBlockSize()*3, blockGrid.getSize().y*blockGrid.getBlockSize()))
-	{
-		this->font = &font;
+		for (std::uint32_t i = 0; i < ticks; ++i)
+		{
+			std::uint8_t keys;
 
-		generate(blockGrid);
+			if (!input(keys))
+				break;
 
-		populateTurrets(turrets, blockGrid);
-		populateMovingTurrets(movingTurrets, blockGrid);
-		//populateMovingSpawningTurrets(movingSpawningTurrets, blockGrid);
+			keys |= governor.getLevel() << inputGovernorShift;
 
-		activeBounds.left = 0;
-		activeBounds.top = 0;
-		activeBounds.width = window.getSize().x*1.1;
-		activeBounds.height = window.getSize().y*1.1;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-		for (int i = 0; i < 1; ++i)
-			startRectanglePositions.push_back(i*600);
+			Outcome outcome = game.tick(keys);
 
-		startRectangle.setPosition(0, 0);
+			tickMicroseconds.push_back(std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count());
 
-		startRectangle.setFillColor(sf::Color(0, 0, 255, 50));
+			governor.record(tickMicroseconds.back());
 
-		for (int i = 0; i < startRectanglePositions.size(); ++i)
-		{
-			sf::RectangleShape rectangle(startRectangle);
+			if (keys & InputGovernor)
+				++governedTicks;
 
-			rectangle.setPosition(startRectanglePositions[i], 0);
+			peakBullets = std::max(peakBullets, game.getBulletCount());
 
-			rectangles.push_back(rectangle);
+			if (outcome != Outcome::Playing)
+				game.tick(InputRestart);
 		}
 
-		endRectangle.setPosition(blockGrid.getBlockSize()*(blockGrid.getSize().x - 3), 0);
-
-		endRectangle.setFillColor(sf::Color(255, 0, 0, 50));
+		spawnedBullets += game.getSpawnedBulletCount() - spawnedBefore;
+		arenaHighWaterMark = std::max(arenaHighWaterMark, game.getArena().getHighWaterMark());
+		gridBytes = std::max(gridBytes, game.getGridMemory().total());
 	}
 
-	Screen * update(sf::RenderWindow & window)
+	void report(Benchmarks & benchmarks, const std::string & name, int games)
 	{
-		sf::Event evt;
-
-		while (window.pollEvent(evt))
-		{
-			if (evt.type == sf::Event::Closed)
-				std::exit(0);
-		}
+		if (tickMicroseconds.empty())
+			return;
 
-		for (Bullet & bullet : bullets)
-			bullet.update();
+		double total = 0;
 
-		activeTurrets.clear();
-		activeMovingTurrets.clear();
-//		activeMovingSpawningTurrets.clear();
+		for (float microseconds : tickMicroseconds)
+			total += microseconds;
 
-		for (Turret & turret : turrets)
-			if (turret.getPosition().x > activeBounds.left - 10 && turret.getPosition().x < activeBounds.left + activeBounds.width + 10 && turret.getPosition().y > activeBounds.top - 10 && turret.getPosition().y < activeBounds.top + activeBounds.height + 10)
-				activeTurrets.push_back(&turret);
+		std::sort(tickMicroseconds.begin(), tickMicroseconds.end());
 
-		for (MovingTurret & turret : movingTurrets)
-			if (turret.getPosition().x > activeBounds.left - 10 && turret.getPosition().x < activeBounds.left + activeBounds.width + 10 && turret.getPosition().y > activeBounds.top - 10 && turret.getPosition().y < activeBounds.top + activeBounds.height + 10)
-				activeMovingTurrets.push_back(&turret);
+		double ticksPerSecond = tickMicroseconds.size()/(total/1e6);
+		double p50 = tickMicroseconds[(tickMicroseconds.size() - 1)/2];
+		double p99 = tickMicroseconds[(tickMicroseconds.size() - 1)*99/100];
+		double max = tickMicroseconds.back();
+		double peakMegabytes = peakMemory()/(1024.0*1024.0);
+		double governed = double(governedTicks)/tickMicroseconds.size();
+		double spawnedPerSecond = double(spawnedBullets)/tickMicroseconds.size()*::ticksPerSecond;
 
-		/*for (MovingSpawningTurret & turret : movingSpawningTurrets)
-			if (turret.getPosition().x > activeBounds.left - 10 && turret.getPosition().x < activeBounds.left + activeBounds.width + 10 && turret.getPosition().y > activeBounds.top - 10 && turret.getPosition().y < activeBounds.top + activeBounds.height + 10)
-				activeMovingSpawningTurrets.push_back(&turret);*/
+		std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1) << std::setw(6) << games << std::setw(9) << tickMicroseconds.size() <<
+			std::setw(12) << ticksPerSecond << std::setw(9) << p50 << std::setw(9) << p99 << std::setw(10) << max << std::setw(9) << peakBullets << std::setw(10) << peakMegabytes << std::setw(10) << gridBytes/1024.0 << std::setw(9) << governed*100 << std::setw(10) << spawnedPerSecond << std::endl;
 
-		if (sf::FloatRect(player.getPosition().x, player.getPosition().y, player.getSize(), player.getSize()).intersects(endRectangle.getGlobalBounds()))
-		{
-			window.setView(window.getDefaultView());
+		BenchmarkResult result = {name, static_cast<long> (tickMicroseconds.size()), total*1000/tickMicroseconds.size(),
+			{{"games", double(games)}, {"ticks_per_second", ticksPerSecond}, {"p50_us", p50}, {"p99_us", p99}, {"max_us", max}, {"peak_bullets", double(peakBullets)}, {"peak_rss_mb", peakMegabytes}, {"arena_high_water_bytes", double(arenaHighWaterMark)}, {"grid_bytes", double(gridBytes)}, {"governed_tick_fraction", governed}, {"spawned_bullets_per_second", spawnedPerSecond}}};
 
-			return new WinScreen(sf::Vector2i(window.getSize().x, window.getSize().y), *font);
-		}
+		benchmarks.add(result);
+	}
+};
 
-		bool playerSafe = false;
+void runGameBenchmarks(Benchmarks & benchmarks, const GameBenchmarkSettings & settings)
+{
+	const sf::Vector2u windowSize(700, 700);
 
-		for (auto rect : rectangles)
-			if (sf::FloatRect(player.getPosition().x, player.getPosition().y, player.getSize(), player.getSize()).intersects(rect.getGlobalBounds()))
-				playerSafe = true;
+	std::cout << std::left << std::setw(40) << "games" << std::right << std::setw(6) << "games" << std::setw(9) << "ticks" << std::setw(12) << "ticks/s" <<
+		std::setw(9) << "p50 us" << std::setw(9) << "p99 us" << std::setw(10) << "max us" << std::setw(9) << "bullets" << std::setw(10) << "RSS MB" << std::setw(10) << "grid KB" << std::setw(9) << "shed %" << std::setw(10) << "spawn/s" << std::endl;
 
-		sf::Vector2f target = player.getPosition();
+	for (sf::Vector2i size : settings.gridSizes)
+		for (float density : settings.turretDensities)
+		{
+			GameStatistics statistics(settings.frameBudget);
 
-		if (playerSafe)
-			target = sf::Vector2f(0, 0);
+			for (std::uint32_t seed = settings.firstSeed; seed <= settings.lastSeed; ++seed)
+			{
+				GameScreen game(windowSize, nullptr, seed, size, density, settings.destructible, settings.blockStorage, settings.detail, settings.patterns, settings.crowd);
 
-		for (Turret * turret : activeTurrets)
-			turret->update(target, bullets, blockGrid);
+				ScriptedPlayer player(seed);
 
-		for (MovingTurret * turret : activeMovingTurrets)
-			turret->update(target, bullets, blockGrid);
+				statistics.run(game, settings.ticksPerGame, [&](std::uint8_t & keys) {keys = player.next(game); return true;});
+			}
 
-		/*for (MovingSpawningTurret * turret : activeMovingSpawningTurrets)
-			turret->update(target, movingSpawningTurrets, bullets, blockGrid);*/
+			std::ostringstream name;
 
-		player.update(blockGrid);
+			name << "games/" << size.x << "x" << size.y << "/turret_density:" << density << (settings.destructible ? "/destructible" : "") << (settings.patterns ? "/patterns" : "") << (settings.crowd ? "/crowd" : "") << (settings.blockStorage == BlockStorage::Runs ? "/runs" : "");
 
-		activeBounds.left = view.getCenter().x - view.getSize().x/2;
-		activeBounds.top = view.getCenter().y - view.getSize().y/2;
+			statistics.report(benchmarks, name.str(), settings.lastSeed - settings.firstSeed + 1);
+		}
 
-		std::vector<Bullet> toRemove;
+	for (const std::string & path : settings.replayPaths)
+	{
+		Replay replay;
 
-		for (Bullet & bullet : bullets)
+		if (!replay.load(path))
 		{
-			if (bullet.getPosition().x < 0 || bullet.getPosition().x >= blockGrid.getBlockSize()*blockGrid.getSize().x || bullet.getPosition().y < 0 || bullet.getPosition().y >= blockGrid.getBlockSize()*blockGrid.getSize().y)
-			{
-				toRemove.push_back(bullet);
-
-				continue;
-			}
+			std::cerr << "Could not load replay " << path << std::endl;
 
-			if (bulletGridCollision(bullet, blockGrid, 25))
-				toRemove.push_back(bullet);
+			continue;
 		}
 
-		for (Bullet & bullet : toRemove)
-			bullets.erase(std::find(bullets.begin(), bullets.end(), bullet));
+		GameScreen game(replay.getWindowSize(), nullptr, replay.getSeed(), replay.getGridSize(), 1, replay.isDestructible(), settings.blockStorage, replay.getDetail(), replay.hasPatterns(), replay.hasCrowd());
 
-		for (Bullet & bullet : bullets)
-			if (!playerSafe && playerBulletCollision(player, bullet))
-			{
-				window.setView(window.getDefaultView());
-				
-				return new DeadScreen(sf::Vector2i(window.getSize().x, window.getSize().y), *font);
-			}
-
-		return this;
-	}
-
-	void draw(sf::RenderTarget & target)
-	{
-		target.clear(sf::Color::White);
+		GameStatistics statistics;
 
-		view.setCenter(player.getPosition());
+		statistics.run(game, replay.getTickCount(), [&](std::uint8_t & keys)
+		{
+			if (replay.finished())
+				return false;
 
-		if (view.getCenter().x - view.getSize().x/2 < 0)
-			view.setCenter(view.getSize().x/2, view.getCenter().y);
+			keys = replay.next();
 
-		if (view.getCenter().y - view.getSize().y/2 < 0)
-			view.setCenter(view.getCenter().x, view.getSize().y/2);
+			return true;
+		});
 
-		if (view.getCenter().x >= blockGrid.getBlockSize()*blockGrid.getSize().x - view.getSize().x/2)
-			view.setCenter(blockGrid.getBlockSize()*blockGrid.getSize().x - view.getSize().x/2, view.getCenter().y);
+		statistics.report(benchmarks, "replay/" + path, 1);
+	}
+}
 
-		if (view.getCenter().y >= blockGrid.getBlockSize()*blockGrid.getSize().y - view.getSize().y/2)
-			view.setCenter(view.getCenter().x, blockGrid.getBlockSize()*blockGrid.getSize().y - view.getSize().y/2);
+//tick times counted in buckets a 64th of a power of two of nanoseconds wide,
+//so any number of ticks takes the same memory and percentiles are within 2%
+class TickHistogram
+{
+	static const int subBuckets = 64;
+	static const int bucketCount = 27*subBuckets;
 
+	std::vector<std::uint64_t> counts;
 
+	std::uint64_t total;
 
-		target.setView(view);
+	double sum;
+	float max;
 
-		blockGrid.draw(target, activeBounds);
+	static int bucketOf(std::uint32_t nanoseconds)
+	{
+		if (nanoseconds < subBuckets)
+			return nanoseconds;
 
-		for (auto rect : rectangles)
-			target.draw(rect);//target.draw(startRectangle);
-		target.draw(endRectangle);
+		int exponent = 6;
 
-		player.draw(target);
+		while (nanoseconds >> (exponent + 1))
+			++exponent;
 
-		for (Bullet & bullet : bullets)
-			bullet.draw(target);
+		return std::min(bucketCount - 1, (exponent - 5)*subBuckets + static_cast<int> (nanoseconds >> (exponent - 6)) - subBuckets);
+	}
 
-		for (Turret * turret : activeTurrets)
-			turret->draw(target);
+	//the smallest time that goes in bucket
+	static float lowestOf(int bucket)
+	{
+		if (bucket < subBuckets)
+			return bucket/1000.f;
 
-		for (MovingTurret * turret : activeMovingTurrets)
-			turret->draw(target);
+		int exponent = bucket/subBuckets + 5;
 
-/*		for (MovingSpawningTurret * turret : activeMovingSpawningTurrets)
-			turret->draw(target);*/
+		return (static_cast<std::uint64_t> (subBuckets + bucket % subBuckets) << (exponent - 6))/1000.f;
 	}
-};
-
-MainMenuScreen::MainMenuScreen(sf::Vector2i windowSize, sf::Font & font) : font(&font)
-{
-	titleText.setFont(font);
-	quitText.setFont(font);
-	playText.setFont(font);
-	instructionsText.setFont(font);
 
-	titleText.setFillColor(sf::Color::Black);
-	titleText.setCharacterSize(30);
-	titleText.setString("Death By Dots");
-	titleText.setOrigin(titleText.getLocalBounds().width/2, titleText.getLocalBounds().height/2);
-	titleText.setPosition(windowSize.x/2, windowSize.y/7);
+public:
+	TickHistogram() : counts(bucketCount, 0), total(0), sum(0), max(0) {}
 
-	playText.setFillColor(sf::Color::Black);
-	playText.setCharacterSize(20);
-	playText.setString("Play");
-	playText.setOrigin(playText.getLocalBounds().width/2, playText.getLocalBounds().height/2);
-	playText.setPosition(windowSize.x/2, windowSize.y/4);
+	void add(float microseconds)
+	{
+		++counts[bucketOf(static_cast<std::uint32_t> (std::min(microseconds*1000.f, 4e9f)))];
+		++total;
 
-	instructionsText.setFillColor(sf::Color::Black);
-	instructionsText.setCharacterSize(20);
-	instructionsText.setString("Instructions");
-	instructionsText.setOrigin(instructionsText.getLocalBounds().width/2, instructionsText.getLocalBounds().height/2);
-	instructionsText.setPosition(windowSize.x/2, windowSize.y/3);
+		sum += microseconds;
+		max = std::max(max, microseconds);
+	}
 
-	quitText.setFillColor(sf::Color::Black);
-	quitText.setCharacterSize(20);
-	quitText.setString("Quit");
-	quitText.setOrigin(quitText.getLocalBounds().width/2, quitText.getLocalBounds().height/2);
-	quitText.setPosition(windowSize.x/2, windowSize.y/2);
-}
+	void merge(const TickHistogram & other)
+	{
+		for (int bucket = 0; bucket < bucketCount; ++bucket)
+			counts[bucket] += other.counts[bucket];
 
-Screen * MainMenuScreen::update(sf::RenderWindow & window)
-{
-	sf::Event evt;
+		total += other.total;
+		sum += other.sum;
+		max = std::max(max, other.max);
+	}
 
-	while (window.pollEvent(evt))
+	//microseconds that fraction of the ticks took no longer than
+	float percentile(double fraction)
 	{
-		if (evt.type == sf::Event::Closed)
-			return nullptr;
+		std::uint64_t rank = static_cast<std::uint64_t> ((total - 1)*fraction);
+		std::uint64_t seen = 0;
 
-		if (evt.type == sf::Event::MouseButtonPressed)
+		for (int bucket = 0; bucket < bucketCount; ++bucket)
 		{
-			if (evt.mouseButton.x >= playText.getGlobalBounds().left && evt.mouseButton.y >= playText.getGlobalBounds().top &&
-				evt.mouseButton.x < playText.getGlobalBounds().left + playText.getGlobalBounds().width &&
-				evt.mouseButton.y < playText.getGlobalBounds().top + playText.getGlobalBounds().height)
-			{
-					return new GameScreen(window, *font);
-			}
-
-			if (evt.mouseButton.x >= instructionsText.getGlobalBounds().left && evt.mouseButton.y >= instructionsText.getGlobalBounds().top &&
-				evt.mouseButton.x < instructionsText.getGlobalBounds().left + instructionsText.getGlobalBounds().width &&
-				evt.mouseButton.y < instructionsText.getGlobalBounds().top + instructionsText.getGlobalBounds().height)
-			{
-				return new InstructionsScreen(sf::Vector2i(window.getSize().x, window.getSize().y), *font);
-			}
+			seen += counts[bucket];
 
-			if (evt.mouseButton.x >= quitText.getGlobalBounds().left && evt.mouseButton.y >= quitText.getGlobalBounds().top &&
-				evt.mouseButton.x < quitText.getGlobalBounds().left + quitText.getGlobalBounds().width &&
-				evt.mouseButton.y < quitText.getGlobalBounds().top + quitText.getGlobalBounds().height)
-			{
-				return nullptr;
-			}
+			if (seen > rank)
+				return std::min(max, lowestOf(bucket + 1));
 		}
+
+		return max;
 	}
 
-	return this;
-}
+	std::uint64_t getCount() {return total;}
+	double getSum() {return sum;}
+	float getMax() {return max;}
+};
 
-void MainMenuScreen::draw(sf::RenderTarget & target)
+const int TickHistogram::subBuckets;
+const int TickHistogram::bucketCount;
+
+//what the games played by one batch worker came to
+struct BatchStatistics
 {
-	target.clear(sf::Color::White);
+	std::uint32_t games;
+	std::uint32_t wins;
+	std::uint32_t deaths;
+
+	std::uint64_t ticks;
+
+	TickHistogram tickMicroseconds;
 
-	target.draw(titleText);
-	target.draw(playText);
-	target.draw(instructionsText);
-	target.draw(quitText);
-}
+	BatchStatistics() : games(0), wins(0), deaths(0), ticks(0) {}
 
-InstructionsScreen::InstructionsScreen(sf::Vector2i windowSize, sf::Font & font)
+	void merge(const BatchStatistics & other)
+	{
+		games += other.games;
+		wins += other.wins;
+		deaths += other.deaths;
+		ticks += other.ticks;
+
+		tickMicroseconds.merge(other.tickMicroseconds);
+	}
+};
+
+//plays every seed once on each size and turret density, as many games at a
+//time as there are threads, each game until it is won or lost or has run out
+//of ticks. Each worker takes the next seed when it finishes a game and keeps
+//its own statistics, so the games share nothing but the seed counter
+void runBatchBenchmarks(Benchmarks & benchmarks, const GameBenchmarkSettings & settings)
 {
-	windowSize = windowSize;
+	const sf::Vector2u windowSize(700, 700);
 
-	this->font = &font;
+	std::cout << std::left << std::setw(40) << "batch" << std::right << std::setw(8) << "threads" << std::setw(7) << "games" << std::setw(10) << "games/s" << std::setw(9) << "speedup" <<
+		std::setw(12) << "ticks/s" << std::setw(8) << "won %" << std::setw(8) << "died %" << std::setw(9) << "ticks" << std::setw(9) << "p50 us" << std::setw(9) << "p99 us" << std::setw(10) << "max us" << std::endl;
 
-	titleText.setFont(font);
-	backText.setFont(font);
-	playerText.setFont(font);
-	bulletText.setFont(font);
-	turretText.setFont(font);
-	movingTurretText.setFont(font);
-	safeZoneText.setFont(font);
-	finishZoneText.setFont(font);
+	for (sf::Vector2i size : settings.gridSizes)
+		for (float density : settings.turretDensities)
+		{
+			double firstGamesPerSecond = 0;
 
+			for (unsigned threadCount : settings.threadCounts)
+			{
+				std::atomic<std::uint32_t> nextSeed(settings.firstSeed);
 
-	titleText.setString("Instructions");
-	titleText.setCharacterSize(30);
-	titleText.setOrigin(titleText.getLocalBounds().width/2, titleText.getLocalBounds().height/5);
-	titleText.setPosition(windowSize.x/2, windowSize.y/7);
-	titleText.setFillColor(sf::Color::Black);
+				std::vector<BatchStatistics> workerStatistics(threadCount);
+				std::vector<std::thread> workers;
 
-	backText.setString("Main Menu");
-	backText.setCharacterSize(20);
-	backText.setOrigin(backText.getLocalBounds().width/2, backText.getLocalBounds().height/2);
-	backText.setPosition(windowSize.x/2, windowSize.y/1.2);
-	backText.setFillColor(sf::Color::Black);
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
+				for (unsigned worker = 0; worker < threadCount; ++worker)
+					workers.push_back(std::thread([&, worker]
+					{
+						TRACE_THREAD("batch worker " + std::to_string(worker));
 
-	Player player;
+						BatchStatistics & statistics = workerStatistics[worker];
 
-	playerRectangle.setSize(sf::Vector2f(player.getSize(), player.getSize()));
-	playerRectangle.setFillColor(sf::Color::Red);
+						for (std::uint32_t seed = nextSeed++; seed <= settings.lastSeed && seed >= settings.firstSeed; seed = nextSeed++)
+						{
+							GameScreen game(windowSize, nullptr, seed, size, density, settings.destructible, settings.blockStorage, settings.detail, settings.patterns, settings.crowd);
 
-	playerRectangle.setPosition(windowSize.x/8, windowSize.y/5);
+							ScriptedPlayer player(seed);
 
-	playerText.setString("This is you. Move with the arrow keys or A,W,S,D.");
-	playerText.setCharacterSize(20);
-	playerText.setPosition(playerRectangle.getPosition().x + playerRectangle.getGlobalBounds().width + 10, playerRectangle.getPosition().y);
-	playerText.setFillColor(sf::Color::Black);
+							Outcome outcome = Outcome::Playing;
 
-	Bullet bullet(sf::Vector2f(), 10, 10, 0);
+							for (std::uint32_t tick = 0; tick < settings.ticksPerGame && outcome == Outcome::Playing; ++tick)
+							{
+								std::uint8_t keys = player.next(game);
 
-	bulletRectangle.setSize(sf::Vector2f(bullet.getSize(), bullet.getSize()));
-	bulletRectangle.setFillColor(sf::Color::Black);
+								std::chrono::steady_clock::time_point tickStart = std::chrono::steady_clock::now();
 
-	bulletRectangle.setPosition(windowSize.x/8, windowSize.y/4);
+								outcome = game.tick(keys);
 
-	bulletText.setString("This is a bullet. Don't get hit by them.");
-	bulletText.setCharacterSize(20);
-	bulletText.setPosition(bulletRectangle.getPosition().x + bulletRectangle.getGlobalBounds().width + 10, bulletRectangle.getPosition().y);
-	bulletText.setFillColor(sf::Color::Black);
+								statistics.tickMicroseconds.add(std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - tickStart).count());
+							}
 
-	Turret turret(sf::Vector2f(), 0);
+							++statistics.games;
 
-	turretRectangle.setSize(sf::Vector2f(turret.getSize(), turret.getSize()));
-	turretRectangle.setFillColor(sf::Color::Yellow);
+							statistics.wins += outcome == Outcome::Won;
+							statistics.deaths += outcome == Outcome::Died;
+						}
+					}));
 
-	turretRectangle.setPosition(windowSize.x/8, windowSize.y/3.5);
+				for (std::thread & worker : workers)
+					worker.join();
 
-	turretText.setString("This is a turret. It shoots bullets");
-	turretText.setCharacterSize(20);
-	turretText.setPosition(turretRectangle.getPosition().x + turretRectangle.getGlobalBounds().width + 10, turretRectangle.getPosition().y);
-	turretText.setFillColor(sf::Color::Black);
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-	MovingTurret movingTurret(sf::Vector2f(), 0, 0);
+				BatchStatistics statistics;
 
-	movingTurretRectangle.setSize(sf::Vector2f(movingTurret.getSize(), movingTurret.getSize()));
-	movingTurretRectangle.setFillColor(sf::Color::Green);
+				for (const BatchStatistics & worker : workerStatistics)
+					statistics.merge(worker);
 
-	movingTurretRectangle.setPosition(windowSize.x/8, windowSize.y/3.f);
+				if (statistics.games == 0)
+					continue;
 
-	movingTurretText.setString("Like a turret, but it moves.");
-	movingTurretText.setCharacterSize(20);
-	movingTurretText.setPosition(movingTurretRectangle.getPosition().x + movingTurretRectangle.getGlobalBounds().width + 10, movingTurretRectangle.getPosition().y);
-	movingTurretText.setFillColor(sf::Color::Black);
+				statistics.ticks = statistics.tickMicroseconds.getCount();
 
-	BlockGrid blockGrid(sf::Vector2i(0, 0));
+				double gamesPerSecond = statistics.games/seconds;
 
-	safeZoneRectangle.setSize(sf::Vector2f(blockGrid.getBlockSize(), blockGrid.getBlockSize()));
-	safeZoneRectangle.setFillColor(sf::Color(0, 0, 255, 50));
+				if (firstGamesPerSecond == 0)
+					firstGamesPerSecond = gamesPerSecond;
 
-	safeZoneRectangle.setPosition(windowSize.x/8, windowSize.y/2.5);
+				double speedup = gamesPerSecond/firstGamesPerSecond;
+				double ticksPerSecond = statistics.ticks/seconds;
+				double won = 100.0*statistics.wins/statistics.games;
+				double died = 100.0*statistics.deaths/statistics.games;
+				double ticksPerGame = double(statistics.ticks)/statistics.games;
+				double p50 = statistics.tickMicroseconds.percentile(0.5);
+				double p99 = statistics.tickMicroseconds.percentile(0.99);
+				double max = statistics.tickMicroseconds.getMax();
 
-	safeZoneText.setString("You are safe when touching this.");
-	safeZoneText.setCharacterSize(20);
-	safeZoneText.setPosition(safeZoneRectangle.getPosition().x + safeZoneRectangle.getGlobalBounds().width + 10, safeZoneRectangle.getPosition().y);
-	safeZoneText.setFillColor(sf::Color::Black);
+				std::ostringstream name;
 
-	finishZoneRectangle.setSize(sf::Vector2f(blockGrid.getBlockSize(), blockGrid.getBlockSize()));
-	finishZoneRectangle.setFillColor(sf::Color(255, 0, 0, 50));
+				name << "batch/" << size.x << "x" << size.y << "/turret_density:" << density << (settings.destructible ? "/destructible" : "") << (settings.patterns ? "/patterns" : "") << (settings.crowd ? "/crowd" : "") << (settings.blockStorage == BlockStorage::Runs ? "/runs" : "") << "/threads:" << threadCount;
 
-	finishZoneRectangle.setPosition(windowSize.x/8, windowSize.y/2);
+				std::cout << std::left << std::setw(40) << name.str().substr(0, name.str().rfind('/')) << std::right << std::fixed << std::setprecision(1) << std::setw(8) << threadCount << std::setw(7) << statistics.games << std::setw(10) << gamesPerSecond << std::setw(9) << speedup <<
+					std::setw(12) << ticksPerSecond << std::setw(8) << won << std::setw(8) << died << std::setw(9) << ticksPerGame << std::setw(9) << p50 << std::setw(9) << p99 << std::setw(10) << max << std::endl;
 
-	finishZoneText.setString("Touch this to win");
-	finishZoneText.setCharacterSize(20);
-	finishZoneText.setPosition(finishZoneRectangle.getPosition().x + finishZoneRectangle.getGlobalBounds().width + 10, finishZoneRectangle.getPosition().y);
-	finishZoneText.setFillColor(sf::Color::Black);
+				BenchmarkResult result = {name.str(), static_cast<long> (statistics.ticks), statistics.tickMicroseconds.getSum()*1000/statistics.ticks,
+					{{"threads", double(threadCount)}, {"games", double(statistics.games)}, {"games_per_second", gamesPerSecond}, {"speedup", speedup}, {"ticks_per_second", ticksPerSecond},
+					{"won_fraction", won/100}, {"died_fraction", died/100}, {"ticks_per_game", ticksPerGame}, {"p50_us", p50}, {"p99_us", p99}, {"max_us", max}}};
+
+				benchmarks.add(result);
+			}
+		}
 }
 
-Screen * InstructionsScreen::update(sf::RenderWindow & window)
+//plays each level through once to warm it up, restarts it and plays the same
+//input again, failing if the second run allocates anything
+int testAllocations()
 {
-	sf::Event evt;
+#ifdef COUNT_ALLOCATIONS
+	const sf::Vector2u windowSize(700, 700);
+	const sf::Vector2i sizes[] = {sf::Vector2i(100, 35), sf::Vector2i(400, 140)};
+	const std::uint32_t ticks = 3000;
 
-	while (window.pollEvent(evt))
-	{
-		if (evt.type == sf::Event::Closed)
-			return nullptr;
+	int failures = 0;
 
-		if (evt.type == sf::Event::MouseButtonPressed)
+	for (sf::Vector2i size : sizes)
+		for (std::uint32_t seed = 1; seed <= 10; ++seed)
 		{
-			if (evt.mouseButton.x >= backText.getGlobalBounds().left && evt.mouseButton.y >= backText.getGlobalBounds().top &&
-				evt.mouseButton.x < backText.getGlobalBounds().left + backText.getGlobalBounds().width &&
-				evt.mouseButton.y < backText.getGlobalBounds().top + backText.getGlobalBounds().height)
-			{
-				return new MainMenuScreen(sf::Vector2i(window.getSize().x, window.getSize().y), *font);
-			}
-		}
-	}
+			GameScreen game(windowSize, nullptr, seed, size, 4);
 
-	return this;
-}
+			ScriptedPlayer player(seed);
 
-void InstructionsScreen::draw(sf::RenderTarget & target)
-{
-	target.clear(sf::Color::White);
+			std::vector<std::uint8_t> inputs;
 
-	target.draw(titleText);
-	target.draw(backText);
-	target.draw(playerText);
-	target.draw(bulletText);
-	target.draw(turretText);
-	target.draw(movingTurretText);
-	target.draw(safeZoneText);
-	target.draw(finishZoneText);
+			inputs.reserve(ticks*2);
 
-	target.draw(playerRectangle);
-	target.draw(bulletRectangle);
-	target.draw(turretRectangle);
-	target.draw(movingTurretRectangle);
-	target.draw(safeZoneRectangle);
-	target.draw(finishZoneRectangle);
-}
+			for (std::uint32_t i = 0; i < ticks; ++i)
+			{
+				std::uint8_t input = player.next(game);
 
-DeadScreen::DeadScreen(sf::Vector2i windowSize, sf::Font & font)
-{
-	this->font = &font;
-	this->windowSize = windowSize;
+				inputs.push_back(input);
 
-	diedText.setFont(font);
-	explanationText.setFont(font);
-	backText.setFont(font);
+				if (game.tick(input) != Outcome::Playing)
+				{
+					inputs.push_back(InputRestart);
 
-	diedText.setFillColor(sf::Color::Black);
-	diedText.setCharacterSize(30);
-	diedText.setString("You died!");
-	diedText.setOrigin(diedText.getLocalBounds().width/2, diedText.getLocalBounds().height/2);
-	diedText.setPosition(windowSize.x/2, windowSize.y/5);
+					game.tick(InputRestart);
+				}
+			}
 
-	explanationText.setFillColor(sf::Color::Black);
-	explanationText.setCharacterSize(20);
-	explanationText.setString("Looks like you just aren't good enough.");
-	explanationText.setOrigin(explanationText.getLocalBounds().width/2, explanationText.getLocalBounds().height/2);
-	explanationText.setPosition(windowSize.x/2, windowSize.y/3);
+			game.tick(InputRestart);
 
-	backText.setFillColor(sf::Color::Black);
-	backText.setCharacterSize(20);
-	backText.setString("Main Menu");
-	backText.setOrigin(backText.getLocalBounds().width/2, backText.getLocalBounds().height/2);
-	backText.setPosition(windowSize.x/2, windowSize.y/2);
-		
-}
+			long before = allocationCount.load();
 
-Screen * DeadScreen::update(sf::RenderWindow & window)
-{
-	sf::Event evt;
+			for (std::uint8_t input : inputs)
+				game.tick(input);
 
-	while (window.pollEvent(evt))
-	{
-		if (evt.type == sf::Event::Closed)
-			return nullptr;
+			long allocations = allocationCount.load() - before;
 
-		if (evt.type == sf::Event::MouseButtonPressed)
-		{
-			if (evt.mouseButton.x >= backText.getGlobalBounds().left && evt.mouseButton.y >= backText.getGlobalBounds().top &&
-				evt.mouseButton.x < backText.getGlobalBounds().left + backText.getGlobalBounds().width &&
-				evt.mouseButton.y < backText.getGlobalBounds().top + backText.getGlobalBounds().height)
+			if (allocations != 0)
 			{
-				return new MainMenuScreen(windowSize, *font);
+				std::cout << "seed " << seed << " " << size.x << "x" << size.y << ": " << allocations << " allocations in " << inputs.size() << " warm ticks" << std::endl;
+
+				++failures;
 			}
 		}
-	}
 
-	return this;
-}
+	std::cout << (failures == 0 ? "no allocations in warm ticks" : "warm ticks allocated") << std::endl;
 
-void DeadScreen::draw(sf::RenderTarget & target)
-{
-	target.clear(sf::Color::White);
-	target.draw(diedText);
-	target.draw(explanationText);
-	target.draw(backText);
-}
+	return failures == 0 ? 0 : 1;
+#else
+	std::cerr << "--test-allocations needs a build with COUNT_ALLOCATIONS defined" << std::endl;
 
+	return 1;
+#endif
+}
 
-WinScreen::WinScreen(sf::Vector2i windowSize, sf::Font & font)
+//parses "a,b,c" with parse run on each piece
+template <typename T, typename Parse> std::vector<T> parseList(const std::string & text, Parse parse)
 {
-	this->font = &font;
-	this->windowSize = windowSize;
+	std::vector<T> values;
 
-	winText.setFont(font);
-	explanationText.setFont(font);
-	backText.setFont(font);
+	std::istringstream stream(text);
 
-	winText.setFillColor(sf::Color::Black);
-	winText.setCharacterSize(30);
-	winText.setString("You win!");
-	winText.setOrigin(winText.getLocalBounds().width/2, winText.getLocalBounds().height/2);
-	winText.setPosition(windowSize.x/2, windowSize.y/5);
+	std::string piece;
 
-	explanationText.setFillColor(sf::Color::Black);
-	explanationText.setCharacterSize(20);
-	explanationText.setString("Get over it.");
-	explanationText.setOrigin(explanationText.getLocalBounds().width/2, explanationText.getLocalBounds().height/2);
-	explanationText.setPosition(windowSize.x/2, windowSize.y/3);
+	while (std::getline(stream, piece, ','))
+		values.push_back(parse(piece));
 
-	backText.setFillColor(sf::Color::Black);
-	backText.setCharacterSize(20);
-	backText.setString("Main Menu");
-	backText.setOrigin(backText.getLocalBounds().width/2, backText.getLocalBounds().height/2);
-	backText.setPosition(windowSize.x/2, windowSize.y/2);
+	return values;
 }
 
-Screen * WinScreen::update(sf::RenderWindow & window)
+void printUsage(const char * program)
 {
-	sf::Event evt;
+	std::cerr << "usage: " << program << " [--record file] [--replay file] [--level file] [--trace file] [--destructible] [--patterns] [--crowd] [--grid-storage bits|runs] [--lod-margin px] [--lod-interval ticks] [--lod-budget turrets] [--frame-budget ms]" << std::endl;
+	std::cerr << "       " << program << " --test-allocations" << std::endl;
+	std::cerr << "       " << program << " --bake file [--seed n] [--width blocks] [--height blocks]" << std::endl;
+	std::cerr << "       " << program << " --bench micro [--bench-out file]" << std::endl;
+	std::cerr << "       " << program << " --bench games [--seeds first-last] [--sizes WxH,...] [--turret-density d,...] [--ticks n] [--destructible] [--patterns] [--crowd] [--grid-storage bits|runs] [--lod-margin px] [--lod-interval ticks] [--lod-budget turrets] [--frame-budget ms] [--bench-replay file]... [--bench-out file]" << std::endl;
+	std::cerr << "       " << program << " --bench batch [--seeds first-last] [--sizes WxH,...] [--turret-density d,...] [--ticks n] [--threads n,...] [--destructible] [--patterns] [--crowd] [--grid-storage bits|runs] [--lod-margin px] [--lod-interval ticks] [--lod-budget turrets] [--bench-out file]" << std::endl;
+}
 
-	while (window.pollEvent(evt))
-	{
-		if (evt.type == sf::Event::Closed)
-			return nullptr;
+int main(int argc, char ** argv)
+{
+	std::string bakePath;
+	std::string replayPath;
+	std::string tracePath;
+	std::string benchmark;
+	std::string benchmarkPath = "benchmark.json";
 
-		if (evt.type == sf::Event::MouseButtonPressed)
+	GameBenchmarkSettings gameBenchmarkSettings;
+
+	std::uint32_t seed = std::random_device()();
+
+	sf::Vector2i gridSize = defaultGridSize(sf::Vector2u(700, 700));
+
+	//numbers that do not parse throw, and are treated like any other bad argument
+	try
+	{
+		for (int i = 1; i < argc; ++i)
 		{
-			if (evt.mouseButton.x >= backText.getGlobalBounds().left && evt.mouseButton.y >= backText.getGlobalBounds().top &&
-				evt.mouseButton.x < backText.getGlobalBounds().left + backText.getGlobalBounds().width &&
-				evt.mouseButton.y < backText.getGlobalBounds().top + backText.getGlobalBounds().height)
+			std::string argument = argv[i];
+
+			if (argument == "--record" && i + 1 < argc)
+				settings.recordPath = argv[++i];
+			else if (argument == "--replay" && i + 1 < argc)
+				replayPath = argv[++i];
+			else if (argument == "--trace" && i + 1 < argc)
+				tracePath = argv[++i];
+			else if (argument == "--bench" && i + 1 < argc)
+				benchmark = argv[++i];
+			else if (argument == "--bench-out" && i + 1 < argc)
+				benchmarkPath = argv[++i];
+			else if (argument == "--seeds" && i + 1 < argc)
 			{
-				return new MainMenuScreen(windowSize, *font);
+				std::string range = argv[++i];
+
+				std::size_t dash = range.find('-');
+
+				gameBenchmarkSettings.firstSeed = std::stoul(range.substr(0, dash));
+				gameBenchmarkSettings.lastSeed = dash == std::string::npos ? gameBenchmarkSettings.firstSeed : std::stoul(range.substr(dash + 1));
+			}
+			else if (argument == "--sizes" && i + 1 < argc)
+				gameBenchmarkSettings.gridSizes = parseList<sf::Vector2i>(argv[++i], [](const std::string & size) {return sf::Vector2i(std::stoi(size), std::stoi(size.substr(size.find('x') + 1)));});
+			else if (argument == "--turret-density" && i + 1 < argc)
+				gameBenchmarkSettings.turretDensities = parseList<float>(argv[++i], [](const std::string & density) {return std::stof(density);});
+			else if (argument == "--ticks" && i + 1 < argc)
+				gameBenchmarkSettings.ticksPerGame = std::stoul(argv[++i]);
+			else if (argument == "--threads" && i + 1 < argc)
+				gameBenchmarkSettings.threadCounts = parseList<unsigned>(argv[++i], [](const std::string & count) {return std::max(1, std::stoi(count));});
+			else if (argument == "--bench-replay" && i + 1 < argc)
+				gameBenchmarkSettings.replayPaths.push_back(argv[++i]);
+			else if (argument == "--test-allocations")
+				return testAllocations();
+			else if (argument == "--destructible")
+				settings.destructible = gameBenchmarkSettings.destructible = true;
+			else if (argument == "--patterns")
+				settings.patterns = gameBenchmarkSettings.patterns = true;
+			else if (argument == "--crowd")
+				settings.crowd = gameBenchmarkSettings.crowd = true;
+			else if (argument == "--lod-margin" && i + 1 < argc)
+				settings.detail.margin = gameBenchmarkSettings.detail.margin = std::max(0, std::stoi(argv[++i]));
+			else if (argument == "--lod-interval" && i + 1 < argc)
+				settings.detail.coarseInterval = gameBenchmarkSettings.detail.coarseInterval = std::max(1, std::stoi(argv[++i]));
+			else if (argument == "--lod-budget" && i + 1 < argc)
+				settings.detail.coarseBudget = gameBenchmarkSettings.detail.coarseBudget = std::max(0, std::stoi(argv[++i]));
+			else if (argument == "--frame-budget" && i + 1 < argc)
+				settings.frameBudget = gameBenchmarkSettings.frameBudget = std::max(0.f, std::stof(argv[++i]));
+			else if (argument == "--grid-storage" && i + 1 < argc && (std::string(argv[i + 1]) == "bits" || std::string(argv[i + 1]) == "runs"))
+				settings.blockStorage = gameBenchmarkSettings.blockStorage = (std::string(argv[++i]) == "runs" ? BlockStorage::Runs : BlockStorage::Bits);
+			else if (argument == "--level" && i + 1 < argc)
+				settings.levelPath = argv[++i];
+			else if (argument == "--bake" && i + 1 < argc)
+				bakePath = argv[++i];
+			else if (argument == "--seed" && i + 1 < argc)
+				seed = std::stoul(argv[++i]);
+			else if (argument == "--width" && i + 1 < argc)
+				gridSize.x = std::stoi(argv[++i]);
+			else if (argument == "--height" && i + 1 < argc)
+				gridSize.y = std::stoi(argv[++i]);
+			else
+			{
+				printUsage(argv[0]);
+
+				return 1;
 			}
 		}
 	}
+	catch (const std::logic_error &)
+	{
+		printUsage(argv[0]);
 
-	return this;
-}
+		return 1;
+	}
 
-void WinScreen::draw(sf::RenderTarget & target)
-{
-	target.clear(sf::Color::White);
-	target.draw(winText);
-	target.draw(explanationText);
-	target.draw(backText);
-}
+	if (!bakePath.empty())
+	{
+		if (gridSize.x <= 0 || gridSize.y <= 0 || !bakeLevel(bakePath, seed, gridSize))
+		{
+			std::cerr << "Could not bake level " << bakePath << std::endl;
 
+			return 1;
+		}
 
+		std::cout << "baked " << gridSize.x << "x" << gridSize.y << " level with seed " << seed << " to " << bakePath << std::endl;
 
+		return 0;
+	}
+
+	if (!tracePath.empty())
+	{
+#ifdef ENABLE_TRACING
+		if (!tracer.start(tracePath))
+		{
+			std::cerr << "Could not write trace to " << tracePath << std::endl;
+
+			return 1;
+		}
+
+		TRACE_THREAD("main");
+#else
+		std::cerr << "--trace needs a build with ENABLE_TRACING defined" << std::endl;
+
+		return 1;
+#endif
+	}
+
+	if (!replayPath.empty())
+		return runReplay(replayPath);
+
+	if (!benchmark.empty())
+	{
+		Benchmarks benchmarks(0.2);
+
+		if (benchmark == "micro")
+			runMicroBenchmarks(benchmarks);
+		else if (benchmark == "games")
+			runGameBenchmarks(benchmarks, gameBenchmarkSettings);
+		else if (benchmark == "batch")
+			runBatchBenchmarks(benchmarks, gameBenchmarkSettings);
+		else
+		{
+			std::cerr << "Unknown benchmark " << benchmark << std::endl;
+
+			return 1;
+		}
+
+		if (!benchmarks.write(benchmarkPath))
+		{
+			std::cerr << "Could not write benchmark results to " << benchmarkPath << std::endl;
+
+			return 1;
+		}
+
+		return 0;
+	}
 
-int main()
-{
 	sf::Font font;
 
 	font.loadFromFile("arial.ttf");
@@ -1545,13 +6521,19 @@ int main()
 
 	while (true)
 	{
-		if (clock.getElapsedTime().asSeconds() > 0.002)
+		if (clock.getElapsedTime().asSeconds() >= 1.f/ticksPerSecond)
 		{
 			clock.restart();
 
 			//UPDATES
 
-			Screen * screen = currentScreen->update(window);
+			Screen * screen;
+
+			{
+				TRACE_SCOPE("update");
+
+				screen = currentScreen->update(window);
+			}
 
 			if (screen == nullptr)
 			{
@@ -1571,11 +6553,13 @@ int main()
 
 			//DRAW
 
+			TRACE_SCOPE("draw");
+
 			currentScreen->draw(window);
 
 			window.display();
 		}
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	}
 }
\ No newline at end of file